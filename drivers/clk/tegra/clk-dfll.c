@@ -2365,6 +2365,8 @@ static const struct clk_ops dfll_clk_ops = {
 static struct clk_init_data dfll_clk_init_data = {
 	.ops		= &dfll_clk_ops,
 	.num_parents	= 0,
+	/* tegra_dfll_fast_set_rate() changes the rate behind the clk core */
+	.flags		= CLK_GET_RATE_NOCACHE,
 };
 
 /**
@@ -2462,6 +2464,34 @@ int tegra_dfll_set_external_floor_mv(int external_floor_mv)
 	return 0;
 }
 
+/**
+ * tegra_dfll_fast_set_rate - set the DFLL rate without going through clk
+ * @rate: target rate in Hz
+ *
+ * Program a new closed loop target directly, for callers such as cpufreq
+ * fast switching that run in scheduler context and cannot take the clk
+ * prepare lock. Only valid while the DFLL is running in closed loop;
+ * returns -EPERM otherwise, -ENODEV if there is no DFLL, or -EINVAL if
+ * @rate is out of range.
+ */
+int tegra_dfll_fast_set_rate(unsigned long rate)
+{
+	struct tegra_dfll *td = tegra_dfll_dev;
+	unsigned long flags;
+	int ret = -EPERM;
+
+	if (!td)
+		return -ENODEV;
+
+	spin_lock_irqsave(&td->lock, flags);
+	if (td->mode == DFLL_CLOSED_LOOP)
+		ret = dfll_request_rate(td, rate);
+	spin_unlock_irqrestore(&td->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dfll_fast_set_rate);
+
 /*
  * Thermal interface
  */
@@ -33,22 +33,83 @@ struct private_data {
 	struct thermal_cooling_device *cdev;
 	const char *reg_name;
 	bool have_static_opps;
+	bool fast_switched;
 };
 
+static int (*dt_set_rate_fast)(unsigned long rate);
+
 static struct freq_attr *cpufreq_dt_attr[] = {
 	&cpufreq_freq_attr_scaling_available_freqs,
 	NULL,   /* Extra space for boost-attr if required */
 	NULL,
 };
 
+/*
+ * Fast switches change the rate behind the clk framework. The clock source
+ * reports its live rate (CLK_GET_RATE_NOCACHE), and reading it refreshes
+ * the cached rate of the CPU clock below it. Do that before trusting
+ * clk_get_rate() again, or the OPP core may skip a change it believes
+ * is already done.
+ */
+static void dt_cpufreq_resync_rate(struct cpufreq_policy *policy)
+{
+	struct private_data *priv = policy->driver_data;
+
+	if (!priv || !priv->fast_switched)
+		return;
+
+	priv->fast_switched = false;
+	clk_get_rate(clk_get_parent(policy->clk));
+}
+
 static int set_target(struct cpufreq_policy *policy, unsigned int index)
 {
 	struct private_data *priv = policy->driver_data;
 
+	dt_cpufreq_resync_rate(policy);
+
 	return dev_pm_opp_set_rate(priv->cpu_dev,
 				   policy->freq_table[index].frequency * 1000);
 }
 
+static unsigned int dt_cpufreq_fast_switch(struct cpufreq_policy *policy,
+					   unsigned int target_freq)
+{
+	struct private_data *priv = policy->driver_data;
+	int index;
+	unsigned int freq;
+
+	index = cpufreq_frequency_table_target(policy, target_freq,
+					       CPUFREQ_RELATION_L);
+	if (index < 0)
+		return CPUFREQ_ENTRY_INVALID;
+
+	freq = policy->freq_table[index].frequency;
+	if (dt_set_rate_fast(freq * 1000UL))
+		return CPUFREQ_ENTRY_INVALID;
+
+	priv->fast_switched = true;
+
+	return freq;
+}
+
+static unsigned int dt_cpufreq_get(unsigned int cpu)
+{
+	struct cpufreq_policy *policy = cpufreq_cpu_get_raw(cpu);
+
+	/*
+	 * Fast switches bypass the clk framework, so its cached rate for the
+	 * CPU clock can't be trusted; policy->cur is kept up to date instead.
+	 */
+	if (policy && policy->fast_switch_enabled)
+		return policy->cur;
+
+	if (policy)
+		dt_cpufreq_resync_rate(policy);
+
+	return cpufreq_generic_get(cpu);
+}
+
 /*
  * An earlier version of opp-v1 bindings used to name the regulator
  * "cpu0-supply", we still need to handle that for backwards compatibility.
@@ -289,6 +350,8 @@ static int cpufreq_init(struct cpufreq_policy *policy)
 	policy->up_transition_delay_us = transition_latency / NSEC_PER_USEC;
 	policy->down_transition_delay_us = 50000; /* 50ms */
 
+	policy->fast_switch_possible = !!dt_set_rate_fast;
+
 	return 0;
 
 out_free_cpufreq_table:
@@ -359,7 +422,7 @@ static struct cpufreq_driver dt_cpufreq_driver = {
 	.flags = CPUFREQ_STICKY | CPUFREQ_NEED_INITIAL_FREQ_CHECK,
 	.verify = cpufreq_generic_frequency_table_verify,
 	.target_index = set_target,
-	.get = cpufreq_generic_get,
+	.get = dt_cpufreq_get,
 	.init = cpufreq_init,
 	.exit = cpufreq_exit,
 	.ready = cpufreq_ready,
@@ -387,6 +450,11 @@ static int dt_cpufreq_probe(struct platform_device *pdev)
 	if (data && data->have_governor_per_policy)
 		dt_cpufreq_driver.flags |= CPUFREQ_HAVE_GOVERNOR_PER_POLICY;
 
+	if (data && data->set_rate_fast) {
+		dt_set_rate_fast = data->set_rate_fast;
+		dt_cpufreq_driver.fast_switch = dt_cpufreq_fast_switch;
+	}
+
 	ret = cpufreq_register_driver(&dt_cpufreq_driver);
 	if (ret)
 		dev_err(&pdev->dev, "failed register driver: %d\n", ret);
@@ -397,6 +465,8 @@ static int dt_cpufreq_probe(struct platform_device *pdev)
 static int dt_cpufreq_remove(struct platform_device *pdev)
 {
 	cpufreq_unregister_driver(&dt_cpufreq_driver);
+	dt_cpufreq_driver.fast_switch = NULL;
+	dt_set_rate_fast = NULL;
 	return 0;
 }
 
@@ -14,6 +14,13 @@
 
 struct cpufreq_dt_platform_data {
 	bool have_governor_per_policy;
+
+	/*
+	 * Optional: set the CPU clock rate without sleeping, for cpufreq
+	 * fast switching. May fail (e.g. while the clock source is in a mode
+	 * where this isn't possible), in which case the rate is unchanged.
+	 */
+	int (*set_rate_fast)(unsigned long rate);
 };
 
 #endif /* __CPUFREQ_DT_H__ */
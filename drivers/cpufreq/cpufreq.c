@@ -1945,8 +1945,8 @@ unsigned int cpufreq_driver_fast_switch(struct cpufreq_policy *policy,
 	int ret;
 	target_freq = clamp_val(target_freq, policy->min, policy->max);
 
-        ret = cpufreq_driver->fast_switch(policy, target_freq);
-	if (ret)
+	ret = cpufreq_driver->fast_switch(policy, target_freq);
+	if (ret && ret != CPUFREQ_ENTRY_INVALID)
 		cpufreq_times_record_transition(policy, ret);
 
 	return ret;
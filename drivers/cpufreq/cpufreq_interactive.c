@@ -28,9 +28,9 @@
 #include <linux/sched/rt.h>
 #include <linux/tick.h>
 #include <linux/time.h>
-#include <linux/timer.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
+#include <trace/events/power.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/cpufreq_interactive.h>
@@ -90,12 +90,12 @@ struct interactive_tunables {
 	bool boosted;
 
 	/*
-	 * Max additional time to wait in idle, beyond sampling_rate, at speeds
-	 * above minimum before wakeup to reduce speed, or -1 if unnecessary.
+	 * Max additional time, beyond sampling_rate, for which the speed
+	 * requested by an idle CPU keeps holding up the speed of its policy,
+	 * or -1 if it never expires.
 	 */
 #define DEFAULT_TIMER_SLACK (4 * DEFAULT_SAMPLING_RATE)
-	unsigned long timer_slack_delay;
-	unsigned long timer_slack;
+	long timer_slack;
 	bool io_is_busy;
 };
 
@@ -104,6 +104,9 @@ struct interactive_policy {
 	struct cpufreq_policy *policy;
 	struct interactive_tunables *tunables;
 	struct list_head tunables_hook;
+
+	/* Serializes fast frequency switches of the policy's CPUs */
+	raw_spinlock_t fast_switch_lock;
 };
 
 /* Separate instance required for each CPU */
@@ -113,20 +116,18 @@ struct interactive_cpu {
 
 	struct irq_work irq_work;
 	u64 last_sample_time;
-	unsigned long next_sample_jiffies;
 	bool work_in_progress;
 
 	struct rw_semaphore enable_sem;
-	struct timer_list slack_timer;
 
-	spinlock_t load_lock; /* protects the next 4 fields */
-	u64 time_in_idle;
-	u64 time_in_idle_timestamp;
-	u64 cputime_speedadj;
-	u64 cputime_speedadj_timestamp;
+	/* Utilization sampled by the scheduler hook, for the irq_work */
+	unsigned long util;
+	unsigned long max;
+	bool iowait;
 
 	spinlock_t target_freq_lock; /*protects target freq */
 	unsigned int target_freq;
+	u64 target_freq_time; /* when target_freq was last evaluated */
 
 	unsigned int floor_freq;
 	u64 pol_floor_val_time; /* policy floor_validate_time */
@@ -137,7 +138,7 @@ struct interactive_cpu {
 
 static DEFINE_PER_CPU(struct interactive_cpu, interactive_cpu);
 
-/* Realtime thread handles frequency scaling */
+/* Realtime thread handles frequency scaling without fast switching */
 static struct task_struct *speedchange_task;
 static cpumask_t speedchange_cpumask;
 static spinlock_t speedchange_cpumask_lock;
@@ -159,65 +160,6 @@ static unsigned int default_above_hispeed_delay[] = {
 static struct interactive_tunables *global_tunables;
 static DEFINE_MUTEX(global_tunables_lock);
 
-static inline void update_slack_delay(struct interactive_tunables *tunables)
-{
-	tunables->timer_slack_delay = usecs_to_jiffies(tunables->timer_slack +
-						       tunables->sampling_rate);
-}
-
-static bool timer_slack_required(struct interactive_cpu *icpu)
-{
-	struct interactive_policy *ipolicy = icpu->ipolicy;
-	struct interactive_tunables *tunables = ipolicy->tunables;
-
-	if (tunables->timer_slack < 0)
-		return false;
-
-	if (icpu->target_freq > ipolicy->policy->min)
-		return true;
-
-	return false;
-}
-
-static void gov_slack_timer_start(struct interactive_cpu *icpu, int cpu)
-{
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-
-	icpu->slack_timer.expires = jiffies + tunables->timer_slack_delay;
-	add_timer_on(&icpu->slack_timer, cpu);
-}
-
-static void gov_slack_timer_modify(struct interactive_cpu *icpu)
-{
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-
-	mod_timer(&icpu->slack_timer, jiffies + tunables->timer_slack_delay);
-}
-
-static void slack_timer_resched(struct interactive_cpu *icpu, int cpu,
-				bool modify)
-{
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-	unsigned long flags;
-
-	spin_lock_irqsave(&icpu->load_lock, flags);
-
-	icpu->time_in_idle = get_cpu_idle_time(cpu,
-					       &icpu->time_in_idle_timestamp,
-					       tunables->io_is_busy);
-	icpu->cputime_speedadj = 0;
-	icpu->cputime_speedadj_timestamp = icpu->time_in_idle_timestamp;
-
-	if (timer_slack_required(icpu)) {
-		if (modify)
-			gov_slack_timer_modify(icpu);
-		else
-			gov_slack_timer_start(icpu, cpu);
-	}
-
-	spin_unlock_irqrestore(&icpu->load_lock, flags);
-}
-
 static unsigned int
 freq_to_above_hispeed_delay(struct interactive_tunables *tunables,
 			    unsigned int freq)
@@ -334,26 +276,123 @@ static unsigned int choose_freq(struct interactive_cpu *icpu,
 	return freq;
 }
 
-static u64 update_load(struct interactive_cpu *icpu, int cpu)
+/*
+ * Express the utilization sampled on this CPU the way interactive has always
+ * expressed load: the percentage of time busy at the current speed, times the
+ * current speed. Utilization is frequency invariant, so this is the speed at
+ * which the CPU would be fully busy, times 100.
+ */
+static unsigned int get_loadadjfreq(struct interactive_cpu *icpu)
+{
+	struct cpufreq_policy *policy = icpu->ipolicy->policy;
+	unsigned int loadadjfreq;
+
+	loadadjfreq = div_u64((u64)icpu->util * policy->cpuinfo.max_freq * 100,
+			      icpu->max);
+
+	/* Count the time spent waiting for I/O as busy, as idle time did */
+	if (icpu->ipolicy->tunables->io_is_busy && icpu->iowait)
+		loadadjfreq = max(loadadjfreq, policy->cur * 100);
+
+	return loadadjfreq;
+}
+
+/*
+ * Without the slack timer waking it up, an idle CPU no longer re-evaluates
+ * its target speed. Its request expires after timer_slack beyond a sampling
+ * period, so that it does not hold up the speed of busy CPUs sharing its
+ * policy.
+ */
+static bool target_freq_expired(struct interactive_cpu *icpu, u64 now)
 {
 	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-	u64 now_idle, now, active_time, delta_idle, delta_time;
 
-	now_idle = get_cpu_idle_time(cpu, &now, tunables->io_is_busy);
-	delta_idle = (now_idle - icpu->time_in_idle);
-	delta_time = (now - icpu->time_in_idle_timestamp);
+	if (tunables->timer_slack < 0)
+		return false;
 
-	if (delta_time <= delta_idle)
-		active_time = 0;
-	else
-		active_time = delta_time - delta_idle;
+	return now - icpu->target_freq_time >
+	       tunables->sampling_rate + tunables->timer_slack;
+}
 
-	icpu->cputime_speedadj += active_time * icpu->ipolicy->policy->cur;
+static void cpufreq_interactive_get_policy_info(unsigned int cpu,
+						struct cpufreq_policy *policy,
+						unsigned int *pmax_freq,
+						u64 *phvt, u64 *pfvt)
+{
+	struct interactive_cpu *icpu;
+	u64 hvt = ~0ULL, fvt = 0;
+	u64 now = ktime_to_us(ktime_get());
+	unsigned int max_freq = 0, i;
 
-	icpu->time_in_idle = now_idle;
-	icpu->time_in_idle_timestamp = now;
+	for_each_cpu(i, policy->cpus) {
+		icpu = &per_cpu(interactive_cpu, i);
+
+		if (i != cpu && target_freq_expired(icpu, now))
+			continue;
+
+		fvt = max(fvt, icpu->loc_floor_val_time);
+		if (icpu->target_freq > max_freq) {
+			max_freq = icpu->target_freq;
+			hvt = icpu->loc_hispeed_val_time;
+		} else if (icpu->target_freq == max_freq) {
+			hvt = min(hvt, icpu->loc_hispeed_val_time);
+		}
+	}
+
+	*pmax_freq = max_freq;
+	*phvt = hvt;
+	*pfvt = fvt;
+}
+
+static void cpufreq_interactive_adjust_cpu(unsigned int cpu,
+					   struct cpufreq_policy *policy)
+{
+	struct interactive_cpu *icpu;
+	u64 hvt, fvt;
+	unsigned int max_freq;
+	int i;
+
+	cpufreq_interactive_get_policy_info(cpu, policy, &max_freq, &hvt, &fvt);
+
+	for_each_cpu(i, policy->cpus) {
+		icpu = &per_cpu(interactive_cpu, i);
+		icpu->pol_floor_val_time = fvt;
+	}
+
+	if (max_freq != policy->cur) {
+		if (policy->fast_switch_enabled) {
+			max_freq = cpufreq_driver_fast_switch(policy, max_freq);
+			if (max_freq == CPUFREQ_ENTRY_INVALID)
+				return;
+
+			policy->cur = max_freq;
+			trace_cpu_frequency(max_freq, smp_processor_id());
+		} else {
+			__cpufreq_driver_target(policy, max_freq,
+						CPUFREQ_RELATION_H);
+		}
 
-	return now;
+		for_each_cpu(i, policy->cpus) {
+			icpu = &per_cpu(interactive_cpu, i);
+			icpu->pol_hispeed_val_time = hvt;
+		}
+	}
+
+	trace_cpufreq_interactive_setspeed(cpu, max_freq, policy->cur);
+}
+
+/*
+ * Switch the speed right away, from the irq_work or with interrupts
+ * disabled, when the driver supports fast switching.
+ */
+static void cpufreq_interactive_fast_switch(unsigned int cpu,
+					    struct interactive_policy *ipolicy)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&ipolicy->fast_switch_lock, flags);
+	cpufreq_interactive_adjust_cpu(cpu, ipolicy->policy);
+	raw_spin_unlock_irqrestore(&ipolicy->fast_switch_lock, flags);
 }
 
 /* Re-evaluate load to see if a frequency change is required or not */
@@ -362,24 +401,17 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
 	struct cpufreq_policy *policy = icpu->ipolicy->policy;
 	struct cpufreq_frequency_table *freq_table = policy->freq_table;
-	u64 cputime_speedadj, now, max_fvtime;
-	unsigned int new_freq, loadadjfreq, index, delta_time;
+	u64 now, max_fvtime;
+	unsigned int new_freq, loadadjfreq, index;
 	unsigned long flags;
 	int cpu_load;
 	int cpu = smp_processor_id();
 
-	spin_lock_irqsave(&icpu->load_lock, flags);
-	now = update_load(icpu, smp_processor_id());
-	delta_time = (unsigned int)(now - icpu->cputime_speedadj_timestamp);
-	cputime_speedadj = icpu->cputime_speedadj;
-	spin_unlock_irqrestore(&icpu->load_lock, flags);
-
-	if (WARN_ON_ONCE(!delta_time))
-		return;
+	now = ktime_to_us(ktime_get());
 
 	spin_lock_irqsave(&icpu->target_freq_lock, flags);
-	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	icpu->target_freq_time = now;
+	loadadjfreq = get_loadadjfreq(icpu);
 	cpu_load = loadadjfreq / policy->cur;
 	tunables->boosted = tunables->boost ||
 			    now < tunables->boostpulse_endtime;
@@ -454,6 +486,11 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	icpu->target_freq = new_freq;
 	spin_unlock_irqrestore(&icpu->target_freq_lock, flags);
 
+	if (policy->fast_switch_enabled) {
+		cpufreq_interactive_fast_switch(cpu, icpu->ipolicy);
+		return;
+	}
+
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
 	cpumask_set_cpu(cpu, &speedchange_cpumask);
 	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
@@ -465,83 +502,6 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	spin_unlock_irqrestore(&icpu->target_freq_lock, flags);
 }
 
-static void cpufreq_interactive_update(struct interactive_cpu *icpu)
-{
-	eval_target_freq(icpu);
-	slack_timer_resched(icpu, smp_processor_id(), true);
-}
-
-static void cpufreq_interactive_idle_end(void)
-{
-	struct interactive_cpu *icpu = &per_cpu(interactive_cpu,
-						smp_processor_id());
-
-	if (!down_read_trylock(&icpu->enable_sem))
-		return;
-
-	if (icpu->ipolicy) {
-		/*
-		 * We haven't sampled load for more than sampling_rate time, do
-		 * it right now.
-		 */
-		if (time_after_eq(jiffies, icpu->next_sample_jiffies))
-			cpufreq_interactive_update(icpu);
-	}
-
-	up_read(&icpu->enable_sem);
-}
-
-static void cpufreq_interactive_get_policy_info(struct cpufreq_policy *policy,
-						unsigned int *pmax_freq,
-						u64 *phvt, u64 *pfvt)
-{
-	struct interactive_cpu *icpu;
-	u64 hvt = ~0ULL, fvt = 0;
-	unsigned int max_freq = 0, i;
-
-	for_each_cpu(i, policy->cpus) {
-		icpu = &per_cpu(interactive_cpu, i);
-
-		fvt = max(fvt, icpu->loc_floor_val_time);
-		if (icpu->target_freq > max_freq) {
-			max_freq = icpu->target_freq;
-			hvt = icpu->loc_hispeed_val_time;
-		} else if (icpu->target_freq == max_freq) {
-			hvt = min(hvt, icpu->loc_hispeed_val_time);
-		}
-	}
-
-	*pmax_freq = max_freq;
-	*phvt = hvt;
-	*pfvt = fvt;
-}
-
-static void cpufreq_interactive_adjust_cpu(unsigned int cpu,
-					   struct cpufreq_policy *policy)
-{
-	struct interactive_cpu *icpu;
-	u64 hvt, fvt;
-	unsigned int max_freq;
-	int i;
-
-	cpufreq_interactive_get_policy_info(policy, &max_freq, &hvt, &fvt);
-
-	for_each_cpu(i, policy->cpus) {
-		icpu = &per_cpu(interactive_cpu, i);
-		icpu->pol_floor_val_time = fvt;
-	}
-
-	if (max_freq != policy->cur) {
-		__cpufreq_driver_target(policy, max_freq, CPUFREQ_RELATION_H);
-		for_each_cpu(i, policy->cpus) {
-			icpu = &per_cpu(interactive_cpu, i);
-			icpu->pol_hispeed_val_time = hvt;
-		}
-	}
-
-	trace_cpufreq_interactive_setspeed(cpu, max_freq, policy->cur);
-}
-
 static int cpufreq_interactive_speedchange_task(void *data)
 {
 	unsigned int cpu;
@@ -576,7 +536,8 @@ static int cpufreq_interactive_speedchange_task(void *data)
 
 		if (likely(icpu->ipolicy)) {
 			policy = icpu->ipolicy->policy;
-			cpufreq_interactive_adjust_cpu(cpu, policy);
+			if (!policy->fast_switch_enabled)
+				cpufreq_interactive_adjust_cpu(cpu, policy);
 		}
 
 		up_read(&icpu->enable_sem);
@@ -591,10 +552,12 @@ static void cpufreq_interactive_boost(struct interactive_tunables *tunables)
 	struct cpufreq_policy *policy;
 	struct interactive_cpu *icpu;
 	unsigned long flags[2];
+	cpumask_t fast_mask;
 	bool wakeup = false;
 	int i;
 
 	tunables->boosted = true;
+	cpumask_clear(&fast_mask);
 
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags[0]);
 
@@ -615,9 +578,14 @@ static void cpufreq_interactive_boost(struct interactive_tunables *tunables)
 			spin_lock_irqsave(&icpu->target_freq_lock, flags[1]);
 			if (icpu->target_freq < tunables->hispeed_freq) {
 				icpu->target_freq = tunables->hispeed_freq;
-				cpumask_set_cpu(i, &speedchange_cpumask);
 				icpu->pol_hispeed_val_time = ktime_to_us(ktime_get());
-				wakeup = true;
+				icpu->target_freq_time = icpu->pol_hispeed_val_time;
+				if (policy->fast_switch_enabled) {
+					cpumask_set_cpu(i, &fast_mask);
+				} else {
+					cpumask_set_cpu(i, &speedchange_cpumask);
+					wakeup = true;
+				}
 			}
 			spin_unlock_irqrestore(&icpu->target_freq_lock, flags[1]);
 
@@ -627,41 +595,22 @@ static void cpufreq_interactive_boost(struct interactive_tunables *tunables)
 
 	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags[0]);
 
-	if (wakeup)
-		wake_up_process(speedchange_task);
-}
-
-static int cpufreq_interactive_notifier(struct notifier_block *nb,
-					unsigned long val, void *data)
-{
-	struct cpufreq_freqs *freq = data;
-	struct interactive_cpu *icpu = &per_cpu(interactive_cpu, freq->cpu);
-	unsigned long flags;
+	for_each_cpu(i, &fast_mask) {
+		icpu = &per_cpu(interactive_cpu, i);
 
-	if (val != CPUFREQ_POSTCHANGE)
-		return 0;
+		if (!down_read_trylock(&icpu->enable_sem))
+			continue;
 
-	if (!down_read_trylock(&icpu->enable_sem))
-		return 0;
+		if (icpu->ipolicy)
+			cpufreq_interactive_fast_switch(i, icpu->ipolicy);
 
-	if (!icpu->ipolicy) {
 		up_read(&icpu->enable_sem);
-		return 0;
 	}
 
-	spin_lock_irqsave(&icpu->load_lock, flags);
-	update_load(icpu, freq->cpu);
-	spin_unlock_irqrestore(&icpu->load_lock, flags);
-
-	up_read(&icpu->enable_sem);
-
-	return 0;
+	if (wakeup)
+		wake_up_process(speedchange_task);
 }
 
-static struct notifier_block cpufreq_notifier_block = {
-	.notifier_call = cpufreq_interactive_notifier,
-};
-
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp = buf;
@@ -881,7 +830,7 @@ static ssize_t store_timer_slack(struct gov_attr_set *attr_set, const char *buf,
 				 size_t count)
 {
 	struct interactive_tunables *tunables = to_tunables(attr_set);
-	unsigned long val;
+	long val;
 	int ret;
 
 	ret = kstrtol(buf, 10, &val);
@@ -889,7 +838,6 @@ static ssize_t store_timer_slack(struct gov_attr_set *attr_set, const char *buf,
 		return ret;
 
 	tunables->timer_slack = val;
-	update_slack_delay(tunables);
 
 	return count;
 }
@@ -974,7 +922,7 @@ static ssize_t store_io_is_busy(struct gov_attr_set *attr_set, const char *buf,
 show_one(hispeed_freq, "%u");
 show_one(go_hispeed_load, "%lu");
 show_one(min_sample_time, "%lu");
-show_one(timer_slack, "%lu");
+show_one(timer_slack, "%ld");
 show_one(boost, "%u");
 show_one(boostpulse_duration, "%u");
 show_one(io_is_busy, "%u");
@@ -1011,23 +959,9 @@ static struct kobj_type interactive_tunables_ktype = {
 	.sysfs_ops = &governor_sysfs_ops,
 };
 
-static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
-					     unsigned long val, void *data)
-{
-	if (val == IDLE_END)
-		cpufreq_interactive_idle_end();
-
-	return 0;
-}
-
-static struct notifier_block cpufreq_interactive_idle_nb = {
-	.notifier_call = cpufreq_interactive_idle_notifier,
-};
-
 /* Interactive Governor callbacks */
 struct interactive_governor {
 	struct cpufreq_governor gov;
-	unsigned int usage_count;
 };
 
 static struct interactive_governor interactive_gov;
@@ -1039,7 +973,8 @@ static void irq_work(struct irq_work *irq_work)
 	struct interactive_cpu *icpu = container_of(irq_work, struct
 						    interactive_cpu, irq_work);
 
-	cpufreq_interactive_update(icpu);
+	eval_target_freq(icpu);
+	icpu->iowait = false;
 	icpu->work_in_progress = false;
 }
 
@@ -1052,6 +987,9 @@ static void update_util_handler(struct update_util_data *data, u64 time,
 	struct interactive_tunables *tunables = ipolicy->tunables;
 	u64 delta_ns;
 
+	if (flags & SCHED_CPUFREQ_IOWAIT)
+		icpu->iowait = true;
+
 	/*
 	 * The irq-work may not be allowed to be queued up right now.
 	 * Possible reasons:
@@ -1066,8 +1004,9 @@ static void update_util_handler(struct update_util_data *data, u64 time,
 		return;
 
 	icpu->last_sample_time = time;
-	icpu->next_sample_jiffies = usecs_to_jiffies(tunables->sampling_rate) +
-				    jiffies;
+	icpu->util = cpufreq_get_util(time, &icpu->max);
+	if (WARN_ON_ONCE(!icpu->max))
+		return;
 
 	icpu->work_in_progress = true;
 	irq_work_queue(&icpu->irq_work);
@@ -1083,7 +1022,7 @@ static void gov_set_update_util(struct interactive_policy *ipolicy)
 		icpu = &per_cpu(interactive_cpu, cpu);
 
 		icpu->last_sample_time = 0;
-		icpu->next_sample_jiffies = 0;
+		icpu->iowait = false;
 		cpufreq_add_update_util_hook(cpu, &icpu->update_util,
 					     update_util_handler);
 	}
@@ -1103,7 +1042,6 @@ static void icpu_cancel_work(struct interactive_cpu *icpu)
 {
 	irq_work_sync(&icpu->irq_work);
 	icpu->work_in_progress = false;
-	del_timer_sync(&icpu->slack_timer);
 }
 
 static struct interactive_policy *
@@ -1116,6 +1054,7 @@ interactive_policy_alloc(struct cpufreq_policy *policy)
 		return NULL;
 
 	ipolicy->policy = policy;
+	raw_spin_lock_init(&ipolicy->fast_switch_lock);
 
 	return ipolicy;
 }
@@ -1161,9 +1100,13 @@ int cpufreq_interactive_init(struct cpufreq_policy *policy)
 	if (policy->governor_data)
 		return -EBUSY;
 
+	cpufreq_enable_fast_switch(policy);
+
 	ipolicy = interactive_policy_alloc(policy);
-	if (!ipolicy)
-		return -ENOMEM;
+	if (!ipolicy) {
+		ret = -ENOMEM;
+		goto disable_fast_switch;
+	}
 
 	mutex_lock(&global_tunables_lock);
 
@@ -1198,7 +1141,6 @@ int cpufreq_interactive_init(struct cpufreq_policy *policy)
 	tunables->boostpulse_duration = DEFAULT_MIN_SAMPLE_TIME;
 	tunables->sampling_rate = DEFAULT_SAMPLING_RATE;
 	tunables->timer_slack = DEFAULT_TIMER_SLACK;
-	update_slack_delay(tunables);
 
 	spin_lock_init(&tunables->target_loads_lock);
 	spin_lock_init(&tunables->above_hispeed_delay_lock);
@@ -1212,13 +1154,6 @@ int cpufreq_interactive_init(struct cpufreq_policy *policy)
 	if (ret)
 		goto fail;
 
-	/* One time initialization for governor */
-	if (!interactive_gov.usage_count++) {
-		idle_notifier_register(&cpufreq_interactive_idle_nb);
-		cpufreq_register_notifier(&cpufreq_notifier_block,
-					  CPUFREQ_TRANSITION_NOTIFIER);
-	}
-
  out:
 	mutex_unlock(&global_tunables_lock);
 	return 0;
@@ -1231,6 +1166,9 @@ int cpufreq_interactive_init(struct cpufreq_policy *policy)
 	mutex_unlock(&global_tunables_lock);
 
 	interactive_policy_free(ipolicy);
+
+ disable_fast_switch:
+	cpufreq_disable_fast_switch(policy);
 	pr_err("governor initialization failed (%d)\n", ret);
 
 	return ret;
@@ -1244,13 +1182,6 @@ void cpufreq_interactive_exit(struct cpufreq_policy *policy)
 
 	mutex_lock(&global_tunables_lock);
 
-	/* Last policy using the governor ? */
-	if (!--interactive_gov.usage_count) {
-		cpufreq_unregister_notifier(&cpufreq_notifier_block,
-					    CPUFREQ_TRANSITION_NOTIFIER);
-		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
-	}
-
 	count = gov_attr_set_put(&tunables->attr_set, &ipolicy->tunables_hook);
 	policy->governor_data = NULL;
 	if (!count)
@@ -1259,6 +1190,7 @@ void cpufreq_interactive_exit(struct cpufreq_policy *policy)
 	mutex_unlock(&global_tunables_lock);
 
 	interactive_policy_free(ipolicy);
+	cpufreq_disable_fast_switch(policy);
 }
 
 int cpufreq_interactive_start(struct cpufreq_policy *policy)
@@ -1276,12 +1208,11 @@ int cpufreq_interactive_start(struct cpufreq_policy *policy)
 		icpu->loc_floor_val_time = icpu->pol_floor_val_time;
 		icpu->pol_hispeed_val_time = icpu->pol_floor_val_time;
 		icpu->loc_hispeed_val_time = icpu->pol_floor_val_time;
+		icpu->target_freq_time = icpu->pol_floor_val_time;
 
 		down_write(&icpu->enable_sem);
 		icpu->ipolicy = ipolicy;
 		up_write(&icpu->enable_sem);
-
-		slack_timer_resched(icpu, cpu, false);
 	}
 
 	gov_set_update_util(ipolicy);
@@ -1313,7 +1244,13 @@ void cpufreq_interactive_limits(struct cpufreq_policy *policy)
 	unsigned int cpu;
 	unsigned long flags;
 
-	cpufreq_policy_apply_limits(policy);
+	/*
+	 * With fast switching, ->target() must never run in parallel with
+	 * ->fast_switch() for the same policy: apply the new limits through
+	 * the fast path once the targets below have been clamped.
+	 */
+	if (!policy->fast_switch_enabled)
+		cpufreq_policy_apply_limits(policy);
 
 	for_each_cpu(cpu, policy->cpus) {
 		icpu = &per_cpu(interactive_cpu, cpu);
@@ -1327,6 +1264,11 @@ void cpufreq_interactive_limits(struct cpufreq_policy *policy)
 
 		spin_unlock_irqrestore(&icpu->target_freq_lock, flags);
 	}
+
+	if (policy->fast_switch_enabled) {
+		icpu = &per_cpu(interactive_cpu, policy->cpu);
+		cpufreq_interactive_fast_switch(policy->cpu, icpu->ipolicy);
+	}
 }
 
 static struct interactive_governor interactive_gov = {
@@ -1342,17 +1284,6 @@ static struct interactive_governor interactive_gov = {
 	}
 };
 
-static void cpufreq_interactive_nop_timer(unsigned long data)
-{
-	/*
-	 * The purpose of slack-timer is to wake up the CPU from IDLE, in order
-	 * to decrease its frequency if it is not set to minimum already.
-	 *
-	 * This is important for platforms where CPU with higher frequencies
-	 * consume higher power even at IDLE.
-	 */
-}
-
 static int __init cpufreq_interactive_gov_init(void)
 {
 	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
@@ -1363,13 +1294,8 @@ static int __init cpufreq_interactive_gov_init(void)
 		icpu = &per_cpu(interactive_cpu, cpu);
 
 		init_irq_work(&icpu->irq_work, irq_work);
-		spin_lock_init(&icpu->load_lock);
 		spin_lock_init(&icpu->target_freq_lock);
 		init_rwsem(&icpu->enable_sem);
-
-		/* Initialize per-cpu slack-timer */
-		init_timer_pinned(&icpu->slack_timer);
-		icpu->slack_timer.function = cpufreq_interactive_nop_timer;
 	}
 
 	spin_lock_init(&speedchange_cpumask_lock);
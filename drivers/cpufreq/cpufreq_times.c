@@ -18,6 +18,7 @@
 #include <linux/cputime.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
@@ -64,6 +65,37 @@ static struct cpu_freqs *all_freqs[NR_CPUS];
 
 static unsigned int next_offset;
 
+/*
+ * Per-UID times are accumulated per CPU and only folded into uid_hash_table
+ * when a batch fills up or when the times are read, so that the tick does
+ * not have to take uid_lock nor touch the shared per-UID arrays.
+ */
+#define UID_BATCH_SIZE 32
+
+/**
+ * struct uid_time - time accumulated by a UID in one accounting bucket
+ * @uid: the UID charged
+ * @state: index in the time_in_state arrays of the frequency run at
+ * @active: index in concurrent_times->active of the number of busy CPUs
+ * @policy: index in concurrent_times->policy, or -1 without a policy
+ * @time: cputime accumulated
+ */
+struct uid_time {
+	uid_t uid;
+	unsigned int state;
+	unsigned int active;
+	int policy;
+	u64 time;
+};
+
+struct uid_time_batch {
+	spinlock_t lock;
+	unsigned int nr;
+	struct uid_time times[UID_BATCH_SIZE];
+};
+
+static DEFINE_PER_CPU(struct uid_time_batch, uid_time_batches);
+
 
 /* Caller must hold rcu_read_lock() */
 static struct uid_entry *find_uid_entry_rcu(uid_t uid)
@@ -137,6 +169,84 @@ static struct uid_entry *find_or_register_uid_locked(uid_t uid)
 	return uid_entry;
 }
 
+/* Caller must hold uid lock */
+static void uid_time_fold_locked(struct uid_time *ut)
+{
+	struct uid_entry *uid_entry;
+	struct concurrent_times *times;
+
+	uid_entry = find_or_register_uid_locked(ut->uid);
+	if (!uid_entry)
+		return;
+
+	if (ut->state < uid_entry->max_state)
+		uid_entry->time_in_state[ut->state] += ut->time;
+
+	times = uid_entry->concurrent_times;
+	atomic64_add(ut->time, &times->active[ut->active]);
+	if (ut->policy >= 0)
+		atomic64_add(ut->time, &times->policy[ut->policy]);
+}
+
+/* Caller must hold batch->lock */
+static void uid_time_batch_fold_locked(struct uid_time_batch *batch)
+{
+	unsigned int i;
+
+	spin_lock(&uid_lock);
+	for (i = 0; i < batch->nr; i++)
+		uid_time_fold_locked(&batch->times[i]);
+	spin_unlock(&uid_lock);
+
+	batch->nr = 0;
+}
+
+/* Fold the times accumulated on every CPU, before they are read */
+static void uid_time_batches_fold(void)
+{
+	struct uid_time_batch *batch;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		batch = &per_cpu(uid_time_batches, cpu);
+
+		spin_lock_irqsave(&batch->lock, flags);
+		if (batch->nr)
+			uid_time_batch_fold_locked(batch);
+		spin_unlock_irqrestore(&batch->lock, flags);
+	}
+}
+
+static void uid_time_batch_add(struct uid_time *ut)
+{
+	struct uid_time_batch *batch;
+	struct uid_time *t;
+	unsigned long flags;
+	unsigned int i;
+
+	local_irq_save(flags);
+	batch = this_cpu_ptr(&uid_time_batches);
+	spin_lock(&batch->lock);
+
+	for (i = 0; i < batch->nr; i++) {
+		t = &batch->times[i];
+		if (t->uid == ut->uid && t->state == ut->state &&
+		    t->active == ut->active && t->policy == ut->policy) {
+			t->time += ut->time;
+			goto out;
+		}
+	}
+
+	if (batch->nr == UID_BATCH_SIZE)
+		uid_time_batch_fold_locked(batch);
+
+	batch->times[batch->nr++] = *ut;
+out:
+	spin_unlock(&batch->lock);
+	local_irq_restore(flags);
+}
+
 static int single_uid_time_in_state_show(struct seq_file *m, void *ptr)
 {
 	struct uid_entry *uid_entry;
@@ -146,6 +256,8 @@ static int single_uid_time_in_state_show(struct seq_file *m, void *ptr)
 	if (uid == overflowuid)
 		return -EINVAL;
 
+	uid_time_batches_fold();
+
 	rcu_read_lock();
 
 	uid_entry = find_uid_entry_rcu(uid);
@@ -169,6 +281,9 @@ static void *uid_seq_start(struct seq_file *seq, loff_t *pos)
 	if (*pos >= HASH_SIZE(uid_hash_table))
 		return NULL;
 
+	if (!*pos)
+		uid_time_batches_fold();
+
 	return &uid_hash_table[*pos];
 }
 
@@ -401,11 +516,9 @@ void cpufreq_acct_update_power(struct task_struct *p, cputime_t cputime)
 	unsigned int state;
 	unsigned int active_cpu_cnt = 0;
 	unsigned int policy_cpu_cnt = 0;
-	unsigned int policy_first_cpu;
-	struct uid_entry *uid_entry;
 	struct cpu_freqs *freqs = all_freqs[task_cpu(p)];
 	struct cpufreq_policy *policy;
-	uid_t uid = from_kuid_munged(current_user_ns(), task_uid(p));
+	struct uid_time ut;
 	int cpu = 0;
 
 	if (!freqs || is_idle_task(p) || p->flags & PF_EXITING)
@@ -419,47 +532,32 @@ void cpufreq_acct_update_power(struct task_struct *p, cputime_t cputime)
 		p->time_in_state[state] += cputime;
 	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
 
-	spin_lock_irqsave(&uid_lock, flags);
-	uid_entry = find_or_register_uid_locked(uid);
-	if (uid_entry && state < uid_entry->max_state)
-		uid_entry->time_in_state[state] += cputime;
-	spin_unlock_irqrestore(&uid_lock, flags);
-
-	rcu_read_lock();
-	uid_entry = find_uid_entry_rcu(uid);
-	if (!uid_entry) {
-		rcu_read_unlock();
-		return;
-	}
-
 	for_each_possible_cpu(cpu)
 		if (!idle_cpu(cpu))
 			++active_cpu_cnt;
 
-	atomic64_add(cputime,
-		     &uid_entry->concurrent_times->active[active_cpu_cnt - 1]);
+	ut.uid = from_kuid_munged(current_user_ns(), task_uid(p));
+	ut.state = state;
+	ut.active = active_cpu_cnt - 1;
+	ut.policy = -1;
+	ut.time = cputime;
 
+	/*
+	 * This CPU may have just come up and not have a cpufreq policy
+	 * yet.
+	 */
 	policy = cpufreq_cpu_get(task_cpu(p));
-	if (!policy) {
-		/*
-		 * This CPU may have just come up and not have a cpufreq policy
-		 * yet.
-		 */
-		rcu_read_unlock();
-		return;
+	if (policy) {
+		for_each_cpu(cpu, policy->related_cpus)
+			if (!idle_cpu(cpu))
+				++policy_cpu_cnt;
+
+		ut.policy = cpumask_first(policy->related_cpus) +
+			    policy_cpu_cnt - 1;
+		cpufreq_cpu_put(policy);
 	}
 
-	for_each_cpu(cpu, policy->related_cpus)
-		if (!idle_cpu(cpu))
-			++policy_cpu_cnt;
-
-	policy_first_cpu = cpumask_first(policy->related_cpus);
-	cpufreq_cpu_put(policy);
-
-	atomic64_add(cputime,
-		     &uid_entry->concurrent_times->policy[policy_first_cpu +
-							  policy_cpu_cnt - 1]);
-	rcu_read_unlock();
+	uid_time_batch_add(&ut);
 }
 
 static int cpufreq_times_get_index(struct cpu_freqs *freqs, unsigned int freq)
@@ -525,6 +623,9 @@ void cpufreq_task_times_remove_uids(uid_t uid_start, uid_t uid_end)
 	struct hlist_node *tmp;
 	unsigned long flags;
 
+	/* Do not let pending times register the UIDs again */
+	uid_time_batches_fold();
+
 	spin_lock_irqsave(&uid_lock, flags);
 
 	for (; uid_start <= uid_end; uid_start++) {
@@ -618,6 +719,11 @@ static const struct file_operations concurrent_policy_time_fops = {
 
 static int __init cpufreq_times_init(void)
 {
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(uid_time_batches, cpu).lock);
+
 	proc_create_data("uid_time_in_state", 0444, NULL,
 			 &uid_time_in_state_fops, NULL);
 
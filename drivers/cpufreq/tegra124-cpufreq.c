@@ -24,6 +24,9 @@
 #include <linux/pm_opp.h>
 #include <linux/regulator/consumer.h>
 #include <linux/types.h>
+#include <soc/tegra/tegra-dfll.h>
+
+#include "cpufreq-dt.h"
 
 struct tegra124_cpufreq_priv {
 	struct regulator *vdd_cpu_reg;
@@ -68,6 +71,21 @@ static void tegra124_cpu_switch_to_pllx(struct tegra124_cpufreq_priv *priv)
 	clk_set_parent(priv->cpu_clk, priv->pllx_clk);
 }
 
+/*
+ * The CPU clock runs off the DFLL for as long as cpufreq-dt is registered,
+ * so rate changes can go straight to the DFLL without taking the clk
+ * prepare lock. This is only possible in closed loop; anything else makes
+ * cpufreq fall back to leaving the rate alone.
+ */
+static int tegra124_cpufreq_set_rate_fast(unsigned long rate)
+{
+	return tegra_dfll_fast_set_rate(rate);
+}
+
+static struct cpufreq_dt_platform_data tegra124_cpufreq_dt_pdata = {
+	.set_rate_fast = tegra124_cpufreq_set_rate_fast,
+};
+
 static int tegra124_cpufreq_probe(struct platform_device *pdev)
 {
 	struct tegra124_cpufreq_priv *priv;
@@ -124,6 +142,8 @@ static int tegra124_cpufreq_probe(struct platform_device *pdev)
 
 	cpufreq_dt_devinfo.name = "cpufreq-dt";
 	cpufreq_dt_devinfo.parent = &pdev->dev;
+	cpufreq_dt_devinfo.data = &tegra124_cpufreq_dt_pdata;
+	cpufreq_dt_devinfo.size_data = sizeof(tegra124_cpufreq_dt_pdata);
 
 	priv->cpufreq_dt_pdev =
 		platform_device_register_full(&cpufreq_dt_devinfo);
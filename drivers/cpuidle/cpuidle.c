@@ -160,6 +160,40 @@ int cpuidle_enter_freeze(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 }
 #endif /* CONFIG_SUSPEND */
 
+/*
+ * Account a misprediction of the idle duration against @index: the state
+ * was too deep if the CPU woke up before its target residency while a
+ * shallower state was available, and too shallow if the CPU stayed idle
+ * long enough for the next deeper available state.
+ */
+static void cpuidle_update_mispredict(struct cpuidle_device *dev,
+				      struct cpuidle_driver *drv, int index)
+{
+	int residency = dev->last_residency;
+	int i;
+
+	if (residency < drv->states[index].target_residency) {
+		for (i = index - 1; i >= 0; i--) {
+			if (drv->states[i].disabled || dev->states_usage[i].disable)
+				continue;
+
+			dev->states_usage[index].above++;
+			break;
+		}
+	} else {
+		residency -= drv->states[index].exit_latency;
+
+		for (i = index + 1; i < drv->state_count; i++) {
+			if (drv->states[i].disabled || dev->states_usage[i].disable)
+				continue;
+
+			if (residency >= (int)drv->states[i].target_residency)
+				dev->states_usage[index].below++;
+			break;
+		}
+	}
+}
+
 /**
  * cpuidle_enter_state - enter the state and update stats
  * @dev: cpuidle device for this cpu
@@ -231,6 +265,8 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 		 */
 		dev->states_usage[entered_state].time += dev->last_residency;
 		dev->states_usage[entered_state].usage++;
+
+		cpuidle_update_mispredict(dev, drv, entered_state);
 	} else {
 		dev->last_residency = 0;
 	}
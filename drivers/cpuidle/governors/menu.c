@@ -12,6 +12,7 @@
 
 #include <linux/kernel.h>
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/pm_qos.h>
 #include <linux/time.h>
 #include <linux/ktime.h>
@@ -87,6 +88,15 @@
  * intervals and if the stand deviation of these 8 intervals is below a
  * threshold value, we use the average of these intervals as prediction.
  *
+ * Device interrupt predictor
+ * --------------------------
+ * Wakeups by device interrupts firing at a regular rate (audio DMA periods,
+ * touch controllers, modems) are neither timers nor necessarily visible in
+ * the last 8 idle intervals, as other wakeups interleave with them. The IRQ
+ * core records the arrival interval of every interrupt line per CPU, and the
+ * earliest expected arrival of a regular line caps the prediction, so that
+ * a deep state is not picked only to be cut short by the next DMA period.
+ *
  * Limiting Performance Impact
  * ---------------------------
  * C states, especially those with large exit latencies, can have a real
@@ -278,6 +288,21 @@ static unsigned int get_typical_interval(struct menu_device *data)
 	goto again;
 }
 
+/*
+ * Time until the next interrupt expected from a regularly firing device on
+ * this CPU, or UINT_MAX if there is none.
+ */
+static unsigned int next_irq_us(void)
+{
+	u64 now = local_clock();
+	u64 next = irq_timings_next_event(now);
+
+	if (next == U64_MAX)
+		return UINT_MAX;
+
+	return min_t(u64, div_u64(next - now, NSEC_PER_USEC), UINT_MAX);
+}
+
 /**
  * menu_select - selects the next idle state to enter
  * @drv: cpuidle driver containing state data
@@ -318,6 +343,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 
 	expected_interval = get_typical_interval(data);
 	expected_interval = min(expected_interval, data->next_timer_us);
+	expected_interval = min(expected_interval, next_irq_us());
 
 	if (CPUIDLE_DRIVER_STATE_START > 0) {
 		struct cpuidle_state *s = &drv->states[CPUIDLE_DRIVER_STATE_START];
@@ -497,6 +523,8 @@ static struct cpuidle_governor menu_governor = {
  */
 static int __init init_menu(void)
 {
+	irq_timings_enable();
+
 	return cpuidle_register_governor(&menu_governor);
 }
 
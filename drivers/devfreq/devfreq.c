@@ -27,6 +27,9 @@
 #include <linux/printk.h>
 #include <linux/hrtimer.h>
 #include <linux/of.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include "governor.h"
 
 static struct class *devfreq_class;
@@ -237,6 +240,215 @@ static int devfreq_notify_transition(struct devfreq *devfreq,
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/* target() latency histogram: bucket n counts latencies below 2^n us */
+#define DEVFREQ_LAT_BUCKETS	16
+#define DEVFREQ_DECISION_LOG	32
+
+/**
+ * struct devfreq_decision - a governor decision and what came out of it
+ * @time:	when target() returned, in ns
+ * @busy_time:	busy time reported in the last status the governor saw
+ * @total_time:	total time reported in the last status the governor saw
+ * @req_freq:	governor request after the min/max limits
+ * @freq:	frequency actually set by target()
+ * @latency_us:	time spent in target()
+ * @err:	return value of target()
+ */
+struct devfreq_decision {
+	u64 time;
+	unsigned long busy_time;
+	unsigned long total_time;
+	unsigned long req_freq;
+	unsigned long freq;
+	u32 latency_us;
+	int err;
+};
+
+/**
+ * struct devfreq_debug - per-device instrumentation exported via debugfs
+ * @dir:		debugfs directory of the device
+ * @lat_hist:		histogram of target() latencies
+ * @lat_total_us:	sum of all target() latencies
+ * @lat_max_us:		worst target() latency seen
+ * @starved_ns:		time spent below the frequency the governor asked for
+ * @starved_since:	start of the current starved period, 0 if none
+ * @log:		ring of the most recent governor decisions
+ * @log_head:		next slot to fill in @log
+ *
+ * Protected by devfreq->lock.
+ */
+struct devfreq_debug {
+	struct dentry *dir;
+	u64 lat_hist[DEVFREQ_LAT_BUCKETS];
+	u64 lat_total_us;
+	u32 lat_max_us;
+	u64 starved_ns;
+	u64 starved_since;
+	struct devfreq_decision log[DEVFREQ_DECISION_LOG];
+	unsigned int log_head;
+};
+
+static struct dentry *devfreq_debugfs_root;
+
+static void devfreq_debug_record(struct devfreq *devfreq,
+				 unsigned long req_freq, unsigned long freq,
+				 ktime_t start, int err)
+{
+	struct devfreq_debug *dbg = devfreq->debug;
+	struct devfreq_decision *d;
+	struct dev_pm_opp *opp;
+	unsigned long floor = req_freq;
+	u64 now = ktime_get_ns();
+	u32 lat = div_u64(now - ktime_to_ns(start), NSEC_PER_USEC);
+
+	if (!dbg)
+		return;
+
+	/*
+	 * Governors may ask for more than the device can do (e.g. UINT_MAX
+	 * from performance); only count as starved the time spent below the
+	 * highest OPP that does not exceed the request.
+	 */
+	rcu_read_lock();
+	opp = dev_pm_opp_find_freq_floor(devfreq->dev.parent, &floor);
+	rcu_read_unlock();
+	if (IS_ERR(opp))
+		floor = req_freq;
+
+	dbg->lat_hist[min_t(int, fls(lat), DEVFREQ_LAT_BUCKETS - 1)]++;
+	dbg->lat_total_us += lat;
+	dbg->lat_max_us = max(dbg->lat_max_us, lat);
+
+	if (dbg->starved_since) {
+		dbg->starved_ns += now - dbg->starved_since;
+		dbg->starved_since = 0;
+	}
+	if (err || freq < floor)
+		dbg->starved_since = now;
+
+	d = &dbg->log[dbg->log_head];
+	dbg->log_head = (dbg->log_head + 1) % DEVFREQ_DECISION_LOG;
+
+	d->time = now;
+	d->busy_time = devfreq->last_status.busy_time;
+	d->total_time = devfreq->last_status.total_time;
+	d->req_freq = req_freq;
+	d->freq = freq;
+	d->latency_us = lat;
+	d->err = err;
+}
+
+static int devfreq_debug_stats_show(struct seq_file *s, void *unused)
+{
+	struct devfreq *devfreq = s->private;
+	struct devfreq_debug *dbg = devfreq->debug;
+	struct devfreq_decision *d;
+	u64 nr = 0, starved_ns;
+	unsigned int i;
+
+	mutex_lock(&devfreq->lock);
+
+	for (i = 0; i < DEVFREQ_LAT_BUCKETS; i++)
+		nr += dbg->lat_hist[i];
+
+	starved_ns = dbg->starved_ns;
+	if (dbg->starved_since)
+		starved_ns += ktime_get_ns() - dbg->starved_since;
+
+	seq_printf(s, "target calls: %llu\n", nr);
+	seq_printf(s, "latency avg(us): %llu\n",
+		   nr ? div64_u64(dbg->lat_total_us, nr) : 0);
+	seq_printf(s, "latency max(us): %u\n", dbg->lat_max_us);
+	seq_printf(s, "below target(ms): %llu\n",
+		   div_u64(starved_ns, NSEC_PER_MSEC));
+
+	seq_puts(s, "\nlatency(us)      count\n");
+	for (i = 0; i < DEVFREQ_LAT_BUCKETS; i++) {
+		if (i == DEVFREQ_LAT_BUCKETS - 1)
+			seq_printf(s, ">= %-10u", 1U << (i - 1));
+		else
+			seq_printf(s, "<  %-10u", 1U << i);
+		seq_printf(s, " %10llu\n", dbg->lat_hist[i]);
+	}
+
+	seq_puts(s, "\n        time(us)       busy      total   req_freq       freq lat(us) err\n");
+	for (i = 0; i < DEVFREQ_DECISION_LOG; i++) {
+		d = &dbg->log[(dbg->log_head + i) % DEVFREQ_DECISION_LOG];
+		if (!d->time)
+			continue;
+
+		seq_printf(s, "%16llu %10lu %10lu %10lu %10lu %7u %3d\n",
+			   div_u64(d->time, NSEC_PER_USEC), d->busy_time,
+			   d->total_time, d->req_freq, d->freq,
+			   d->latency_us, d->err);
+	}
+
+	mutex_unlock(&devfreq->lock);
+
+	return 0;
+}
+
+static int devfreq_debug_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, devfreq_debug_stats_show, inode->i_private);
+}
+
+static const struct file_operations devfreq_debug_stats_fops = {
+	.open		= devfreq_debug_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void devfreq_debugfs_add(struct devfreq *devfreq)
+{
+	struct devfreq_debug *dbg;
+
+	if (!devfreq_debugfs_root)
+		return;
+
+	dbg = kzalloc(sizeof(*dbg), GFP_KERNEL);
+	if (!dbg)
+		return;
+
+	dbg->dir = debugfs_create_dir(dev_name(&devfreq->dev),
+				      devfreq_debugfs_root);
+	if (!dbg->dir ||
+	    !debugfs_create_file("stats", S_IRUGO, dbg->dir, devfreq,
+				 &devfreq_debug_stats_fops)) {
+		debugfs_remove_recursive(dbg->dir);
+		kfree(dbg);
+		return;
+	}
+
+	devfreq->debug = dbg;
+}
+
+static void devfreq_debugfs_remove(struct devfreq *devfreq)
+{
+	if (!devfreq->debug)
+		return;
+
+	debugfs_remove_recursive(devfreq->debug->dir);
+	kfree(devfreq->debug);
+	devfreq->debug = NULL;
+}
+
+static void __init devfreq_debugfs_init(void)
+{
+	devfreq_debugfs_root = debugfs_create_dir("devfreq", NULL);
+}
+#else
+static inline void devfreq_debug_record(struct devfreq *devfreq,
+					unsigned long req_freq,
+					unsigned long freq,
+					ktime_t start, int err) { }
+static inline void devfreq_debugfs_add(struct devfreq *devfreq) { }
+static inline void devfreq_debugfs_remove(struct devfreq *devfreq) { }
+static inline void devfreq_debugfs_init(void) { }
+#endif
+
 /* Load monitoring helper functions for governors use */
 
 /**
@@ -249,7 +461,8 @@ static int devfreq_notify_transition(struct devfreq *devfreq,
 int update_devfreq(struct devfreq *devfreq)
 {
 	struct devfreq_freqs freqs;
-	unsigned long freq, cur_freq;
+	unsigned long freq, req_freq, cur_freq;
+	ktime_t start;
 	int err = 0;
 	u32 flags = 0;
 
@@ -286,6 +499,8 @@ int update_devfreq(struct devfreq *devfreq)
 		flags |= DEVFREQ_FLAG_LEAST_UPPER_BOUND; /* Use LUB */
 	}
 
+	req_freq = freq;
+
 	if (devfreq->profile->get_cur_freq)
 		devfreq->profile->get_cur_freq(devfreq->dev.parent, &cur_freq);
 	else
@@ -295,7 +510,10 @@ int update_devfreq(struct devfreq *devfreq)
 	freqs.new = freq;
 	devfreq_notify_transition(devfreq, &freqs, DEVFREQ_PRECHANGE);
 
+	start = ktime_get();
 	err = devfreq->profile->target(devfreq->dev.parent, &freq, flags);
+	devfreq_debug_record(devfreq, req_freq, err ? cur_freq : freq,
+			     start, err);
 	if (err) {
 		freqs.new = cur_freq;
 		devfreq_notify_transition(devfreq, &freqs, DEVFREQ_POSTCHANGE);
@@ -536,6 +754,7 @@ static void _remove_devfreq(struct devfreq *devfreq)
 	if (devfreq->profile->exit)
 		devfreq->profile->exit(devfreq->dev.parent);
 
+	devfreq_debugfs_remove(devfreq);
 	mutex_destroy(&devfreq->lock);
 	kfree(devfreq);
 }
@@ -628,6 +847,8 @@ struct devfreq *devfreq_add_device(struct device *dev,
 
 	srcu_init_notifier_head(&devfreq->transition_notifier_list);
 
+	devfreq_debugfs_add(devfreq);
+
 	mutex_unlock(&devfreq->lock);
 
 	mutex_lock(&devfreq_list_lock);
@@ -657,6 +878,7 @@ struct devfreq *devfreq_add_device(struct device *dev,
 	list_del(&devfreq->node);
 	mutex_unlock(&devfreq_list_lock);
 
+	devfreq_debugfs_remove(devfreq);
 	device_unregister(&devfreq->dev);
 err_dev:
 	if (devfreq)
@@ -1345,6 +1567,8 @@ static int __init devfreq_init(void)
 	}
 	devfreq_class->dev_groups = devfreq_groups;
 
+	devfreq_debugfs_init();
+
 	return 0;
 }
 subsys_initcall(devfreq_init);
@@ -24,10 +24,13 @@
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/platform_device.h>
 #include <linux/pm_opp.h>
 #include <linux/reset.h>
 
+#include <soc/tegra/tegra_emc.h>
+
 #include "governor.h"
 
 #define ACTMON_GLB_STATUS					0x0
@@ -170,6 +173,9 @@ struct tegra_devfreq {
 	unsigned long		cur_freq;
 	struct notifier_block	rate_change_nb;
 
+	/* Floor derived from the client bandwidth requests, in kHz */
+	unsigned long		bw_floor_freq;
+
 	struct tegra_devfreq_device devices[ARRAY_SIZE(actmon_device_configs)];
 };
 
@@ -178,6 +184,24 @@ struct tegra_actmon_emc_ratio {
 	unsigned long emc_freq;
 };
 
+/**
+ * struct tegra_devfreq_bw_req - bandwidth declared by an EMC client
+ *
+ * Bandwidths are in KB/s.
+ */
+struct tegra_devfreq_bw_req {
+	unsigned long avg_bw;
+	unsigned long peak_bw;
+};
+
+/*
+ * Requests may be declared before the ACTMON device probes, so they live
+ * outside of struct tegra_devfreq. bw_req_lock nests outside devfreq->lock.
+ */
+static DEFINE_MUTEX(bw_req_lock);
+static struct tegra_devfreq_bw_req bw_reqs[EMC_USER_NUM];
+static struct tegra_devfreq *bw_req_devfreq;
+
 static struct tegra_actmon_emc_ratio actmon_emc_ratios[] = {
 	{ 1400000, ULONG_MAX },
 	{ 1200000,    750000 },
@@ -368,6 +392,73 @@ static void actmon_update_target(struct tegra_devfreq *tegra,
 	spin_unlock_irqrestore(&dev->lock, flags);
 }
 
+/*
+ * Aggregate the client requests: average bandwidth adds up while peaks
+ * from different clients are assumed not to coincide, so only the largest
+ * one needs to be met. Must be called with bw_req_lock held.
+ */
+static unsigned long tegra_devfreq_bw_floor(void)
+{
+	unsigned long total_bw = 0, peak_bw = 0;
+	u32 usage_flags = 0;
+	unsigned int i;
+
+	for (i = 0; i < EMC_USER_NUM; i++) {
+		if (!bw_reqs[i].avg_bw && !bw_reqs[i].peak_bw)
+			continue;
+
+		total_bw += bw_reqs[i].avg_bw;
+		peak_bw = max(peak_bw, bw_reqs[i].peak_bw);
+		usage_flags |= BIT(i);
+	}
+
+	if (!usage_flags)
+		return 0;
+
+	return tegra210_emc_bw_to_rate(total_bw, peak_bw, usage_flags) / KHZ;
+}
+
+static void tegra_devfreq_update_bw_floor(struct tegra_devfreq *tegra)
+{
+	unsigned long floor = tegra_devfreq_bw_floor();
+
+	mutex_lock(&tegra->devfreq->lock);
+	tegra->bw_floor_freq = floor;
+	update_devfreq(tegra->devfreq);
+	mutex_unlock(&tegra->devfreq->lock);
+}
+
+/**
+ * tegra_emc_request_bw() - declare the EMC bandwidth needed by a client
+ * @user:	the client making the request
+ * @avg_bw:	sustained bandwidth, in KB/s
+ * @peak_bw:	bandwidth that must be met during bursts, in KB/s
+ *
+ * The aggregate of all requests is used as a floor for the frequency
+ * picked from the ACTMON counters, so that bursts from isochronous clients
+ * do not have to wait for the counters to catch up. Passing 0 for both
+ * bandwidths drops the request. May sleep.
+ */
+int tegra_emc_request_bw(enum emc_user_id user, unsigned long avg_bw,
+			 unsigned long peak_bw)
+{
+	if (user >= EMC_USER_NUM)
+		return -EINVAL;
+
+	mutex_lock(&bw_req_lock);
+
+	bw_reqs[user].avg_bw = avg_bw;
+	bw_reqs[user].peak_bw = peak_bw;
+
+	if (bw_req_devfreq)
+		tegra_devfreq_update_bw_floor(bw_req_devfreq);
+
+	mutex_unlock(&bw_req_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_emc_request_bw);
+
 static irqreturn_t actmon_thread_isr(int irq, void *data)
 {
 	struct tegra_devfreq *tegra = data;
@@ -566,7 +657,7 @@ static int tegra_governor_get_target(struct devfreq *devfreq,
 		target_freq = max(target_freq, dev->target_freq);
 	}
 
-	*freq = target_freq;
+	*freq = max(target_freq, tegra->bw_floor_freq);
 
 	return 0;
 }
@@ -710,6 +801,13 @@ static int tegra_devfreq_probe(struct platform_device *pdev)
 						 &tegra_devfreq_profile,
 						 "tegra_actmon",
 						 NULL);
+	if (IS_ERR(tegra->devfreq))
+		return PTR_ERR(tegra->devfreq);
+
+	mutex_lock(&bw_req_lock);
+	bw_req_devfreq = tegra;
+	tegra_devfreq_update_bw_floor(tegra);
+	mutex_unlock(&bw_req_lock);
 
 	return 0;
 }
@@ -721,6 +819,10 @@ static int tegra_devfreq_remove(struct platform_device *pdev)
 	u32 val;
 	unsigned int i;
 
+	mutex_lock(&bw_req_lock);
+	bw_req_devfreq = NULL;
+	mutex_unlock(&bw_req_lock);
+
 	for (i = 0; i < ARRAY_SIZE(actmon_device_configs); i++) {
 		val = device_readl(&tegra->devices[i], ACTMON_DEV_CTRL);
 		val &= ~ACTMON_DEV_CTRL_ENB;
@@ -740,6 +842,7 @@ static int tegra_devfreq_remove(struct platform_device *pdev)
 
 static const struct of_device_id tegra_devfreq_of_match[] = {
 	{ .compatible = "nvidia,tegra124-actmon" },
+	{ .compatible = "nvidia,tegra210-actmon" },
 	{ },
 };
 
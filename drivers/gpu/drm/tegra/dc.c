@@ -14,6 +14,7 @@
 #include <linux/reset.h>
 
 #include <soc/tegra/pmc.h>
+#include <soc/tegra/tegra_emc.h>
 
 #include "dc.h"
 #include "drm.h"
@@ -949,6 +950,7 @@ static void tegra_dc_finish_page_flip(struct tegra_dc *dc)
 	struct drm_device *drm = dc->base.dev;
 	struct drm_crtc *crtc = &dc->base;
 	unsigned long flags, base;
+	bool latched = true;
 	struct tegra_bo *bo;
 
 	spin_lock_irqsave(&drm->event_lock, flags);
@@ -958,19 +960,28 @@ static void tegra_dc_finish_page_flip(struct tegra_dc *dc)
 		return;
 	}
 
-	bo = tegra_fb_get_plane(crtc->primary->fb, 0);
+	/*
+	 * Without a primary framebuffer there is no start address to check,
+	 * the new state has been latched by the time VBLANK is signalled.
+	 */
+	if (crtc->primary->fb) {
+		bo = tegra_fb_get_plane(crtc->primary->fb, 0);
 
-	spin_lock(&dc->lock);
+		spin_lock(&dc->lock);
 
-	/* check if new start address has been latched */
-	tegra_dc_writel(dc, WINDOW_A_SELECT, DC_CMD_DISPLAY_WINDOW_HEADER);
-	tegra_dc_writel(dc, READ_MUX, DC_CMD_STATE_ACCESS);
-	base = tegra_dc_readl(dc, DC_WINBUF_START_ADDR);
-	tegra_dc_writel(dc, 0, DC_CMD_STATE_ACCESS);
+		/* check if new start address has been latched */
+		tegra_dc_writel(dc, WINDOW_A_SELECT,
+				DC_CMD_DISPLAY_WINDOW_HEADER);
+		tegra_dc_writel(dc, READ_MUX, DC_CMD_STATE_ACCESS);
+		base = tegra_dc_readl(dc, DC_WINBUF_START_ADDR);
+		tegra_dc_writel(dc, 0, DC_CMD_STATE_ACCESS);
+
+		spin_unlock(&dc->lock);
 
-	spin_unlock(&dc->lock);
+		latched = base == bo->paddr + crtc->primary->fb->offsets[0];
+	}
 
-	if (base == bo->paddr + crtc->primary->fb->offsets[0]) {
+	if (latched) {
 		drm_crtc_send_vblank_event(crtc, dc->event);
 		drm_crtc_vblank_put(crtc);
 		dc->event = NULL;
@@ -1167,6 +1178,63 @@ static int tegra_dc_wait_idle(struct tegra_dc *dc, unsigned long timeout)
 	return -ETIMEDOUT;
 }
 
+/*
+ * Memory bandwidth needed to scan out the planes of the CRTC's current
+ * state, in KB/s: on average over a frame, and at peak while all planes
+ * are fetched at the pixel clock.
+ */
+static void tegra_crtc_get_bw(struct drm_crtc *crtc, unsigned long *avg_bw,
+			      unsigned long *peak_bw)
+{
+	struct drm_display_mode *mode = &crtc->state->adjusted_mode;
+	int refresh = drm_mode_vrefresh(mode);
+	struct drm_plane *plane;
+
+	*avg_bw = 0;
+	*peak_bw = 0;
+
+	if (!crtc->state->active)
+		return;
+
+	drm_atomic_crtc_for_each_plane(plane, crtc) {
+		struct drm_plane_state *state = plane->state;
+		unsigned int cpp;
+
+		if (!state->fb)
+			continue;
+
+		cpp = state->fb->bits_per_pixel / 8;
+		*avg_bw += (unsigned long)(state->src_w >> 16) *
+			   (state->src_h >> 16) * cpp / 1000 * refresh;
+		*peak_bw += (unsigned long)mode->clock * cpp;
+	}
+}
+
+static void tegra_dc_request_bw(struct tegra_dc *dc, unsigned long avg_bw,
+				unsigned long peak_bw)
+{
+	if (avg_bw == dc->avg_bw && peak_bw == dc->peak_bw)
+		return;
+
+	tegra_emc_request_bw(dc->pipe ? EMC_USER_DC2 : EMC_USER_DC1,
+			     avg_bw, peak_bw);
+	dc->avg_bw = avg_bw;
+	dc->peak_bw = peak_bw;
+}
+
+/*
+ * Settle the EMC bandwidth request on what the current planes need. The
+ * request may have been raised for both the old and the new planes while
+ * a flip was pending, so this must only be called once it has latched.
+ */
+void tegra_dc_update_bw(struct tegra_dc *dc)
+{
+	unsigned long avg_bw, peak_bw;
+
+	tegra_crtc_get_bw(&dc->base, &avg_bw, &peak_bw);
+	tegra_dc_request_bw(dc, avg_bw, peak_bw);
+}
+
 static void tegra_crtc_disable(struct drm_crtc *crtc)
 {
 	struct tegra_dc *dc = to_tegra_dc(crtc);
@@ -1205,9 +1273,22 @@ static void tegra_crtc_disable(struct drm_crtc *crtc)
 		tegra_dc_writel(dc, value, DC_CMD_DISPLAY_POWER_CONTROL);
 	}
 
+	/* the flip will never be latched, so complete it now */
+	spin_lock_irq(&crtc->dev->event_lock);
+
+	if (dc->event) {
+		drm_crtc_send_vblank_event(crtc, dc->event);
+		drm_crtc_vblank_put(crtc);
+		dc->event = NULL;
+	}
+
+	spin_unlock_irq(&crtc->dev->event_lock);
+
 	tegra_dc_stats_reset(&dc->stats);
 	drm_crtc_vblank_off(crtc);
 
+	tegra_dc_request_bw(dc, 0, 0);
+
 	pm_runtime_put_sync(dc->dev);
 }
 
@@ -1297,6 +1378,15 @@ static void tegra_crtc_atomic_begin(struct drm_crtc *crtc,
 				    struct drm_crtc_state *old_crtc_state)
 {
 	struct tegra_dc *dc = to_tegra_dc(crtc);
+	unsigned long avg_bw, peak_bw;
+
+	/*
+	 * Raise the EMC bandwidth request before the new planes are latched;
+	 * lowering it waits for the flip to land, see tegra_dc_update_bw().
+	 */
+	tegra_crtc_get_bw(crtc, &avg_bw, &peak_bw);
+	tegra_dc_request_bw(dc, max(avg_bw, dc->avg_bw),
+			    max(peak_bw, dc->peak_bw));
 
 	if (crtc->state->event) {
 		crtc->state->event->pipe = drm_crtc_index(crtc);
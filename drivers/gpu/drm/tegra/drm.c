@@ -29,82 +29,71 @@ struct tegra_drm_file {
 	struct mutex lock;
 };
 
-static void tegra_atomic_schedule(struct tegra_drm *tegra,
-				  struct drm_atomic_state *state)
-{
-	tegra->commit.state = state;
-	schedule_work(&tegra->commit.work);
-}
-
-static void tegra_atomic_complete(struct tegra_drm *tegra,
-				  struct drm_atomic_state *state)
+/*
+ * CRTCs that are inactive after the commit never latch new state, so their
+ * completion events would otherwise never be signalled. Complete them right
+ * away so that out-fences and waiters on subsequent commits are released.
+ */
+static void tegra_atomic_complete_inactive(struct drm_atomic_state *old_state)
 {
-	struct drm_device *drm = tegra->drm;
-
-	/*
-	 * Everything below can be run asynchronously without the need to grab
-	 * any modeset locks at all under one condition: It must be guaranteed
-	 * that the asynchronous work has either been cancelled (if the driver
-	 * supports it, which at least requires that the framebuffers get
-	 * cleaned up with drm_atomic_helper_cleanup_planes()) or completed
-	 * before the new state gets committed on the software side with
-	 * drm_atomic_helper_swap_state().
-	 *
-	 * This scheme allows new atomic state updates to be prepared and
-	 * checked in parallel to the asynchronous completion of the previous
-	 * update. Which is important since compositors need to figure out the
-	 * composition of the next frame right after having submitted the
-	 * current layout.
-	 */
-
-	drm_atomic_helper_commit_modeset_disables(drm, state);
-	drm_atomic_helper_commit_modeset_enables(drm, state);
-	drm_atomic_helper_commit_planes(drm, state,
-					DRM_PLANE_COMMIT_ACTIVE_ONLY);
+	struct drm_device *drm = old_state->dev;
+	struct drm_crtc_state *old_crtc_state;
+	struct drm_crtc *crtc;
+	unsigned long flags;
+	unsigned int i;
 
-	drm_atomic_helper_wait_for_vblanks(drm, state);
+	for_each_crtc_in_state(old_state, crtc, old_crtc_state, i) {
+		if (crtc->state->active || !crtc->state->event)
+			continue;
 
-	drm_atomic_helper_cleanup_planes(drm, state);
-	drm_atomic_state_free(state);
+		spin_lock_irqsave(&drm->event_lock, flags);
+		drm_crtc_send_vblank_event(crtc, crtc->state->event);
+		crtc->state->event = NULL;
+		spin_unlock_irqrestore(&drm->event_lock, flags);
+	}
 }
 
-static void tegra_atomic_work(struct work_struct *work)
+/*
+ * The new planes are being scanned out once the flips have latched, so
+ * drop the EMC bandwidth kept for the old planes.
+ */
+static void tegra_atomic_update_bw(struct drm_atomic_state *old_state)
 {
-	struct tegra_drm *tegra = container_of(work, struct tegra_drm,
-					       commit.work);
+	struct drm_crtc_state *old_crtc_state;
+	struct drm_crtc *crtc;
+	unsigned int i;
 
-	tegra_atomic_complete(tegra, tegra->commit.state);
+	for_each_crtc_in_state(old_state, crtc, old_crtc_state, i) {
+		if (crtc->state->active)
+			tegra_dc_update_bw(to_tegra_dc(crtc));
+	}
 }
 
-static int tegra_atomic_commit(struct drm_device *drm,
-			       struct drm_atomic_state *state, bool nonblock)
+/*
+ * Non-blocking commits are queued per CRTC by the atomic helpers and run
+ * from a worker once all in-fences of the new plane states have signalled.
+ * The display controller latches the new state on the next VBLANK, where
+ * tegra_dc_finish_page_flip() sends the completion event and thereby also
+ * signals the CRTC's out-fence. Only CRTCs touched by a commit are waited
+ * on, so independent outputs no longer serialize against each other.
+ */
+static void tegra_atomic_commit_tail(struct drm_atomic_state *old_state)
 {
-	struct tegra_drm *tegra = drm->dev_private;
-	int err;
+	struct drm_device *drm = old_state->dev;
 
-	err = drm_atomic_helper_prepare_planes(drm, state);
-	if (err)
-		return err;
-
-	/* serialize outstanding nonblocking commits */
-	mutex_lock(&tegra->commit.lock);
-	flush_work(&tegra->commit.work);
+	drm_atomic_helper_commit_modeset_disables(drm, old_state);
+	drm_atomic_helper_commit_modeset_enables(drm, old_state);
+	drm_atomic_helper_commit_planes(drm, old_state,
+					DRM_PLANE_COMMIT_ACTIVE_ONLY);
 
-	/*
-	 * This is the point of no return - everything below never fails except
-	 * when the hw goes bonghits. Which means we can commit the new state on
-	 * the software side now.
-	 */
+	tegra_atomic_complete_inactive(old_state);
+	drm_atomic_helper_commit_hw_done(old_state);
 
-	drm_atomic_helper_swap_state(state, true);
+	drm_atomic_helper_wait_for_vblanks(drm, old_state);
 
-	if (nonblock)
-		tegra_atomic_schedule(tegra, state);
-	else
-		tegra_atomic_complete(tegra, state);
+	tegra_atomic_update_bw(old_state);
 
-	mutex_unlock(&tegra->commit.lock);
-	return 0;
+	drm_atomic_helper_cleanup_planes(drm, old_state);
 }
 
 static const struct drm_mode_config_funcs tegra_drm_mode_funcs = {
@@ -113,7 +102,11 @@ static const struct drm_mode_config_funcs tegra_drm_mode_funcs = {
 	.output_poll_changed = tegra_fb_output_poll_changed,
 #endif
 	.atomic_check = drm_atomic_helper_check,
-	.atomic_commit = tegra_atomic_commit,
+	.atomic_commit = drm_atomic_helper_commit,
+};
+
+static struct drm_mode_config_helper_funcs tegra_drm_mode_config_helpers = {
+	.atomic_commit_tail = tegra_atomic_commit_tail,
 };
 
 static int tegra_drm_load(struct drm_device *drm, unsigned long flags)
@@ -145,15 +138,18 @@ static int tegra_drm_load(struct drm_device *drm, unsigned long flags)
 		drm_mm_init(&tegra->mm, start, end - start + 1);
 	}
 
+	mutex_init(&tegra->mm_lock);
+
 	mutex_init(&tegra->clients_lock);
 	INIT_LIST_HEAD(&tegra->clients);
 
-	mutex_init(&tegra->commit.lock);
-	INIT_WORK(&tegra->commit.work, tegra_atomic_work);
-
 	drm->dev_private = tegra;
 	tegra->drm = drm;
 
+	err = tegra_bo_cache_init(drm);
+	if (err < 0)
+		goto domain;
+
 	drm_mode_config_init(drm);
 
 	drm->mode_config.min_width = 0;
@@ -163,6 +159,7 @@ static int tegra_drm_load(struct drm_device *drm, unsigned long flags)
 	drm->mode_config.max_height = 4096;
 
 	drm->mode_config.funcs = &tegra_drm_mode_funcs;
+	drm->mode_config.helper_private = &tegra_drm_mode_config_helpers;
 
 	err = tegra_drm_fb_prepare(drm);
 	if (err < 0)
@@ -205,7 +202,8 @@ static int tegra_drm_load(struct drm_device *drm, unsigned long flags)
 	tegra_drm_fb_free(drm);
 config:
 	drm_mode_config_cleanup(drm);
-
+	tegra_bo_cache_fini(drm);
+domain:
 	if (tegra->domain) {
 		iommu_domain_free(tegra->domain);
 		drm_mm_takedown(&tegra->mm);
@@ -230,6 +228,8 @@ static int tegra_drm_unload(struct drm_device *drm)
 	if (err < 0)
 		return err;
 
+	tegra_bo_cache_fini(drm);
+
 	if (tegra->domain) {
 		iommu_domain_free(tegra->domain);
 		drm_mm_takedown(&tegra->mm);
@@ -351,6 +351,7 @@ int tegra_drm_submit(struct tegra_drm_context *context,
 	if (!job)
 		return -ENOMEM;
 
+	job->submit_ktime = ktime_get();
 	job->num_relocs = args->num_relocs;
 	job->num_waitchk = args->num_waitchks;
 	job->client = (u32)args->context;
@@ -957,13 +958,26 @@ static int tegra_debugfs_iova(struct seq_file *s, void *data)
 	struct drm_info_node *node = (struct drm_info_node *)s->private;
 	struct drm_device *drm = node->minor->dev;
 	struct tegra_drm *tegra = drm->dev_private;
+	int err;
+
+	mutex_lock(&tegra->mm_lock);
+	err = drm_mm_dump_table(s, &tegra->mm);
+	mutex_unlock(&tegra->mm_lock);
+
+	return err;
+}
+
+static int tegra_debugfs_bo_cache(struct seq_file *s, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *)s->private;
 
-	return drm_mm_dump_table(s, &tegra->mm);
+	return tegra_bo_cache_show(s, node->minor->dev);
 }
 
 static struct drm_info_list tegra_debugfs_list[] = {
 	{ "framebuffers", tegra_debugfs_framebuffers, 0 },
 	{ "iova", tegra_debugfs_iova, 0 },
+	{ "bo_cache", tegra_debugfs_bo_cache, 0 },
 };
 
 static int tegra_debugfs_init(struct drm_minor *minor)
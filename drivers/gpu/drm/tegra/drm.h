@@ -41,8 +41,11 @@ struct tegra_drm {
 	struct drm_device *drm;
 
 	struct iommu_domain *domain;
+	struct mutex mm_lock;
 	struct drm_mm mm;
 
+	struct tegra_bo_cache bo_cache;
+
 	struct mutex clients_lock;
 	struct list_head clients;
 
@@ -52,12 +55,6 @@ struct tegra_drm {
 
 	unsigned int pitch_align;
 
-	struct {
-		struct drm_atomic_state *state;
-		struct work_struct work;
-		struct mutex lock;
-	} commit;
-
 	struct drm_atomic_state *state;
 };
 
@@ -144,6 +141,10 @@ struct tegra_dc {
 	const struct tegra_dc_soc_info *soc;
 
 	struct iommu_domain *domain;
+
+	/* EMC bandwidth currently requested for scanout, in KB/s */
+	unsigned long avg_bw;
+	unsigned long peak_bw;
 };
 
 static inline struct tegra_dc *
@@ -196,6 +197,7 @@ u32 tegra_dc_get_vblank_counter(struct tegra_dc *dc);
 void tegra_dc_enable_vblank(struct tegra_dc *dc);
 void tegra_dc_disable_vblank(struct tegra_dc *dc);
 void tegra_dc_commit(struct tegra_dc *dc);
+void tegra_dc_update_bw(struct tegra_dc *dc);
 int tegra_dc_state_setup_clock(struct tegra_dc *dc,
 			       struct drm_crtc_state *crtc_state,
 			       struct clk *clk, unsigned long pclk,
@@ -14,6 +14,7 @@
  */
 
 #include <linux/dma-buf.h>
+#include <linux/highmem.h>
 #include <linux/iommu.h>
 #include <drm/tegra_drm.h>
 
@@ -98,8 +99,10 @@ static int tegra_bo_iommu_map(struct tegra_drm *tegra, struct tegra_bo *bo)
 	if (!bo->mm)
 		return -ENOMEM;
 
+	mutex_lock(&tegra->mm_lock);
 	err = drm_mm_insert_node_generic(&tegra->mm, bo->mm, bo->gem.size,
 					 PAGE_SIZE, 0, 0, 0);
+	mutex_unlock(&tegra->mm_lock);
 	if (err < 0) {
 		dev_err(tegra->drm->dev, "out of I/O virtual memory: %zd\n",
 			err);
@@ -120,7 +123,9 @@ static int tegra_bo_iommu_map(struct tegra_drm *tegra, struct tegra_bo *bo)
 	return 0;
 
 remove:
+	mutex_lock(&tegra->mm_lock);
 	drm_mm_remove_node(bo->mm);
+	mutex_unlock(&tegra->mm_lock);
 free:
 	kfree(bo->mm);
 	return err;
@@ -132,7 +137,11 @@ static int tegra_bo_iommu_unmap(struct tegra_drm *tegra, struct tegra_bo *bo)
 		return 0;
 
 	iommu_unmap(tegra->domain, bo->paddr, bo->size);
+
+	mutex_lock(&tegra->mm_lock);
 	drm_mm_remove_node(bo->mm);
+	mutex_unlock(&tegra->mm_lock);
+
 	kfree(bo->mm);
 
 	return 0;
@@ -149,6 +158,8 @@ static struct tegra_bo *tegra_bo_alloc_object(struct drm_device *drm,
 		return ERR_PTR(-ENOMEM);
 
 	host1x_bo_init(&bo->base, &tegra_bo_ops);
+	INIT_LIST_HEAD(&bo->cache_bucket);
+	INIT_LIST_HEAD(&bo->cache_lru);
 	size = round_up(size, PAGE_SIZE);
 
 	err = drm_gem_object_init(drm, &bo->gem, size);
@@ -245,12 +256,287 @@ static int tegra_bo_alloc(struct drm_device *drm, struct tegra_bo *bo)
 	return 0;
 }
 
+/*
+ * Tear down a buffer object including its backing storage and mapping.
+ */
+static void tegra_bo_destroy(struct drm_device *drm, struct tegra_bo *bo)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+
+	if (tegra->domain)
+		tegra_bo_iommu_unmap(tegra, bo);
+
+	tegra_bo_free(drm, bo);
+	drm_gem_object_release(&bo->gem);
+	kfree(bo);
+}
+
+static unsigned int tegra_bo_cache_bucket(size_t size)
+{
+	unsigned int bucket = ilog2(size >> PAGE_SHIFT);
+
+	return min_t(unsigned int, bucket, TEGRA_BO_CACHE_BUCKETS - 1);
+}
+
+static void tegra_bo_cache_dispose(struct drm_device *drm,
+				   struct list_head *list)
+{
+	struct tegra_bo *bo, *tmp;
+
+	list_for_each_entry_safe(bo, tmp, list, cache_lru) {
+		list_del_init(&bo->cache_lru);
+		tegra_bo_destroy(drm, bo);
+	}
+}
+
+/*
+ * Move up to nr_pages worth of the least recently cached buffer objects
+ * (or all of them if nr_pages is 0) onto a dispose list.
+ * Must be called with the cache lock held.
+ */
+static unsigned long tegra_bo_cache_evict(struct tegra_bo_cache *cache,
+					  unsigned long nr_pages,
+					  struct list_head *dispose)
+{
+	unsigned long freed = 0;
+	struct tegra_bo *bo;
+
+	while (!list_empty(&cache->lru)) {
+		if (nr_pages && freed >= nr_pages)
+			break;
+
+		bo = list_last_entry(&cache->lru, struct tegra_bo, cache_lru);
+		list_del_init(&bo->cache_bucket);
+		list_move(&bo->cache_lru, dispose);
+
+		cache->size -= bo->gem.size;
+		cache->evictions++;
+		freed += bo->gem.size >> PAGE_SHIFT;
+	}
+
+	return freed;
+}
+
+/*
+ * Stash the backing storage and IOMMU mapping of a buffer object that is
+ * being freed so that a later allocation of the same size can reuse them.
+ * The GEM object itself is reinitialized on reuse, but its shmem file is
+ * kept because the cached pages belong to it.
+ */
+static bool tegra_bo_cache_put(struct drm_device *drm, struct tegra_bo *bo)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	size_t size = bo->gem.size;
+	LIST_HEAD(dispose);
+
+	if (bo->gem.import_attach || size > TEGRA_BO_CACHE_MAX_SIZE / 4)
+		return false;
+
+	if (!bo->pages && !bo->vaddr)
+		return false;
+
+	drm_gem_free_mmap_offset(&bo->gem);
+
+	mutex_lock(&cache->lock);
+
+	list_add(&bo->cache_bucket,
+		 &cache->buckets[tegra_bo_cache_bucket(size)]);
+	list_add(&bo->cache_lru, &cache->lru);
+	cache->size += size;
+
+	if (cache->size > TEGRA_BO_CACHE_MAX_SIZE)
+		tegra_bo_cache_evict(cache, (cache->size -
+				     TEGRA_BO_CACHE_MAX_SIZE) >> PAGE_SHIFT,
+				     &dispose);
+
+	mutex_unlock(&cache->lock);
+
+	tegra_bo_cache_dispose(drm, &dispose);
+
+	return true;
+}
+
+/*
+ * Clear a recycled buffer so that no data leaks between its users.
+ */
+static void tegra_bo_clear(struct drm_device *drm, struct tegra_bo *bo)
+{
+	unsigned long i;
+
+	if (bo->pages) {
+		for (i = 0; i < bo->num_pages; i++)
+			clear_highpage(bo->pages[i]);
+
+		dma_sync_sg_for_device(drm->dev, bo->sgt->sgl, bo->sgt->nents,
+				       DMA_TO_DEVICE);
+	} else {
+		memset(bo->vaddr, 0, bo->gem.size);
+		wmb();
+	}
+}
+
+static struct tegra_bo *tegra_bo_cache_get(struct drm_device *drm,
+					   size_t size)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	struct tegra_bo *bo, *found = NULL;
+	struct list_head *bucket;
+	struct file *filp;
+	int err;
+
+	size = round_up(size, PAGE_SIZE);
+	bucket = &cache->buckets[tegra_bo_cache_bucket(size)];
+
+	mutex_lock(&cache->lock);
+
+	list_for_each_entry(bo, bucket, cache_bucket) {
+		if (bo->gem.size == size) {
+			list_del_init(&bo->cache_bucket);
+			list_del_init(&bo->cache_lru);
+			cache->size -= size;
+			found = bo;
+			break;
+		}
+	}
+
+	if (found)
+		cache->hits++;
+	else
+		cache->misses++;
+
+	mutex_unlock(&cache->lock);
+
+	if (!found)
+		return NULL;
+
+	bo = found;
+
+	/* reset the GEM object but keep the shmem file backing the pages */
+	filp = bo->gem.filp;
+	drm_gem_private_object_init(drm, &bo->gem, size);
+	bo->gem.filp = filp;
+
+	host1x_bo_init(&bo->base, &tegra_bo_ops);
+	memset(&bo->tiling, 0, sizeof(bo->tiling));
+	bo->flags = 0;
+
+	err = drm_gem_create_mmap_offset(&bo->gem);
+	if (err < 0) {
+		tegra_bo_destroy(drm, bo);
+		return NULL;
+	}
+
+	tegra_bo_clear(drm, bo);
+
+	return bo;
+}
+
+static unsigned long tegra_bo_cache_count(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+	struct tegra_bo_cache *cache =
+		container_of(shrinker, struct tegra_bo_cache, shrinker);
+
+	return READ_ONCE(cache->size) >> PAGE_SHIFT;
+}
+
+static unsigned long tegra_bo_cache_scan(struct shrinker *shrinker,
+					 struct shrink_control *sc)
+{
+	struct tegra_bo_cache *cache =
+		container_of(shrinker, struct tegra_bo_cache, shrinker);
+	struct tegra_drm *tegra =
+		container_of(cache, struct tegra_drm, bo_cache);
+	unsigned long freed;
+	LIST_HEAD(dispose);
+
+	if (!mutex_trylock(&cache->lock))
+		return SHRINK_STOP;
+
+	freed = tegra_bo_cache_evict(cache, sc->nr_to_scan, &dispose);
+	mutex_unlock(&cache->lock);
+
+	tegra_bo_cache_dispose(tegra->drm, &dispose);
+
+	return freed;
+}
+
+int tegra_bo_cache_init(struct drm_device *drm)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	unsigned int i;
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->lru);
+
+	for (i = 0; i < TEGRA_BO_CACHE_BUCKETS; i++)
+		INIT_LIST_HEAD(&cache->buckets[i]);
+
+	cache->shrinker.count_objects = tegra_bo_cache_count;
+	cache->shrinker.scan_objects = tegra_bo_cache_scan;
+	cache->shrinker.seeks = DEFAULT_SEEKS;
+
+	return register_shrinker(&cache->shrinker);
+}
+
+void tegra_bo_cache_fini(struct drm_device *drm)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	LIST_HEAD(dispose);
+
+	unregister_shrinker(&cache->shrinker);
+
+	mutex_lock(&cache->lock);
+	tegra_bo_cache_evict(cache, 0, &dispose);
+	mutex_unlock(&cache->lock);
+
+	tegra_bo_cache_dispose(drm, &dispose);
+}
+
+int tegra_bo_cache_show(struct seq_file *s, struct drm_device *drm)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	unsigned int i, count;
+	struct tegra_bo *bo;
+
+	mutex_lock(&cache->lock);
+
+	seq_printf(s, "size: %zu/%u bytes\n", cache->size,
+		   TEGRA_BO_CACHE_MAX_SIZE);
+	seq_printf(s, "hits: %lu misses: %lu evictions: %lu\n",
+		   cache->hits, cache->misses, cache->evictions);
+
+	for (i = 0; i < TEGRA_BO_CACHE_BUCKETS; i++) {
+		count = 0;
+
+		list_for_each_entry(bo, &cache->buckets[i], cache_bucket)
+			count++;
+
+		if (count)
+			seq_printf(s, "bucket %2u (%lu pages+): %u\n", i,
+				   1UL << i, count);
+	}
+
+	mutex_unlock(&cache->lock);
+
+	return 0;
+}
+
 struct tegra_bo *tegra_bo_create(struct drm_device *drm, size_t size,
 				 unsigned long flags)
 {
 	struct tegra_bo *bo;
 	int err;
 
+	bo = tegra_bo_cache_get(drm, size);
+	if (bo)
+		goto done;
+
 	bo = tegra_bo_alloc_object(drm, size);
 	if (IS_ERR(bo))
 		return bo;
@@ -259,6 +545,7 @@ struct tegra_bo *tegra_bo_create(struct drm_device *drm, size_t size,
 	if (err < 0)
 		goto release;
 
+done:
 	if (flags & DRM_TEGRA_GEM_CREATE_TILED)
 		bo->tiling.mode = TEGRA_BO_TILING_MODE_TILED;
 
@@ -362,6 +649,9 @@ void tegra_bo_free_object(struct drm_gem_object *gem)
 	struct tegra_drm *tegra = gem->dev->dev_private;
 	struct tegra_bo *bo = to_tegra_bo(gem);
 
+	if (tegra_bo_cache_put(gem->dev, bo))
+		return;
+
 	if (tegra->domain)
 		tegra_bo_iommu_unmap(tegra, bo);
 
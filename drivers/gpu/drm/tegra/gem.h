@@ -12,6 +12,8 @@
 #define __HOST1X_GEM_H
 
 #include <linux/host1x.h>
+#include <linux/shrinker.h>
+#include <linux/sizes.h>
 
 #include <drm/drm.h>
 #include <drm/drmP.h>
@@ -45,6 +47,32 @@ struct tegra_bo {
 	size_t size;
 
 	struct tegra_bo_tiling tiling;
+
+	/* entries in the reuse cache bucket and LRU lists */
+	struct list_head cache_bucket;
+	struct list_head cache_lru;
+};
+
+/*
+ * Freed, already backed (and IOMMU-mapped) buffer objects are kept in a
+ * per-device cache so that clients reallocating same-sized buffers every
+ * frame skip the page allocation and IOMMU map/unmap. Buckets are indexed
+ * by log2 of the page count and looked up by exact size.
+ */
+#define TEGRA_BO_CACHE_BUCKETS 16
+#define TEGRA_BO_CACHE_MAX_SIZE SZ_32M
+
+struct tegra_bo_cache {
+	struct mutex lock;
+	struct list_head buckets[TEGRA_BO_CACHE_BUCKETS];
+	struct list_head lru;
+	size_t size;
+
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+
+	struct shrinker shrinker;
 };
 
 static inline struct tegra_bo *to_tegra_bo(struct drm_gem_object *gem)
@@ -60,6 +88,9 @@ struct tegra_bo *tegra_bo_create_with_handle(struct drm_file *file,
 					     unsigned long flags,
 					     u32 *handle);
 void tegra_bo_free_object(struct drm_gem_object *gem);
+int tegra_bo_cache_init(struct drm_device *drm);
+void tegra_bo_cache_fini(struct drm_device *drm);
+int tegra_bo_cache_show(struct seq_file *s, struct drm_device *drm);
 int tegra_bo_dumb_create(struct drm_file *file, struct drm_device *drm,
 			 struct drm_mode_create_dumb *args);
 int tegra_bo_dumb_map_offset(struct drm_file *file, struct drm_device *drm,
@@ -122,6 +122,73 @@ static u32 host1x_pushbuffer_space(struct push_buffer *pb)
 	return ((pb->fence - pb->pos) & (pb->size_bytes - 1)) / 8;
 }
 
+/*
+ * Account a latency sample in microseconds into a log2 histogram
+ */
+static void host1x_latency_hist_add(struct host1x_latency_hist *hist, s64 us)
+{
+	unsigned int bucket;
+
+	if (us < 0)
+		us = 0;
+
+	bucket = us < 2 ? 0 : ilog2(us);
+	if (bucket >= HOST1X_LATENCY_BUCKETS)
+		bucket = HOST1X_LATENCY_BUCKETS - 1;
+
+	hist->buckets[bucket]++;
+	hist->count++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
+static void host1x_job_stats_add(struct host1x_job_stats *stats,
+				 s64 queue_us, s64 exec_us)
+{
+	host1x_latency_hist_add(&stats->queue, queue_us);
+	host1x_latency_hist_add(&stats->exec, exec_us);
+	host1x_latency_hist_add(&stats->total, queue_us + exec_us);
+}
+
+/*
+ * Record submit-to-kick and kick-to-completion latency of a finished job,
+ * both for its channel and for the client class that submitted it.
+ * Must be called with the cdma lock held.
+ */
+static void cdma_record_job_locked(struct host1x_cdma *cdma,
+				   struct host1x_job *job, ktime_t now)
+{
+	struct host1x *host1x = cdma_to_host1x(cdma);
+	struct host1x_client_stats *cs = NULL;
+	s64 queue_us, exec_us;
+	unsigned int i;
+
+	queue_us = ktime_us_delta(job->push_ktime, job->submit_ktime);
+	exec_us = ktime_us_delta(now, job->push_ktime);
+
+	host1x_job_stats_add(&cdma->stats.jobs, queue_us, exec_us);
+
+	if (!job->class)
+		return;
+
+	spin_lock(&host1x->stats_lock);
+
+	for (i = 0; i < HOST1X_NUM_CLIENT_STATS; i++) {
+		if (host1x->client_stats[i].class == job->class ||
+		    !host1x->client_stats[i].class) {
+			cs = &host1x->client_stats[i];
+			cs->class = job->class;
+			break;
+		}
+	}
+
+	if (cs)
+		host1x_job_stats_add(&cs->jobs, queue_us, exec_us);
+
+	spin_unlock(&host1x->stats_lock);
+}
+
 /*
  * Sleep (if necessary) until the requested event happens
  *   - CDMA_EVENT_SYNC_QUEUE_EMPTY : sync queue is completely empty.
@@ -223,11 +290,14 @@ static void update_cdma_locked(struct host1x_cdma *cdma)
 	bool signal = false;
 	struct host1x *host1x = cdma_to_host1x(cdma);
 	struct host1x_job *job, *n;
+	ktime_t now;
 
 	/* If CDMA is stopped, queue is cleared and we can return */
 	if (!cdma->running)
 		return;
 
+	now = ktime_get();
+
 	/*
 	 * Walk the sync queue, reading the sync point registers as necessary,
 	 * to consume as many sync queue entries as possible without blocking
@@ -262,6 +332,9 @@ static void update_cdma_locked(struct host1x_cdma *cdma)
 				signal = true;
 		}
 
+		cdma_record_job_locked(cdma, job, now);
+		cdma->stats.queue_depth--;
+
 		list_del(&job->list);
 		host1x_job_put(job);
 	}
@@ -382,6 +455,8 @@ int host1x_cdma_init(struct host1x_cdma *cdma)
 	cdma->running = false;
 	cdma->torndown = false;
 
+	memset(&cdma->stats, 0, sizeof(cdma->stats));
+
 	err = host1x_pushbuffer_init(&cdma->push_buffer);
 	if (err)
 		return err;
@@ -477,15 +552,29 @@ void host1x_cdma_end(struct host1x_cdma *cdma,
 		     struct host1x_job *job)
 {
 	struct host1x *host1x = cdma_to_host1x(cdma);
+	struct push_buffer *pb = &cdma->push_buffer;
 	bool idle = list_empty(&cdma->sync_queue);
+	unsigned int used;
 
 	host1x_hw_cdma_flush(host1x, cdma);
 
+	job->push_ktime = ktime_get();
+	if (!job->submit_ktime.tv64)
+		job->submit_ktime = job->push_ktime;
+
 	job->first_get = cdma->first_get;
 	job->num_slots = cdma->slots_used;
 	host1x_job_get(job);
 	list_add_tail(&job->list, &cdma->sync_queue);
 
+	/* one slot always stays free, see host1x_pushbuffer_space() */
+	used = pb->size_bytes / 8 - 1 - host1x_pushbuffer_space(pb);
+	cdma->stats.pb_high_water = max(cdma->stats.pb_high_water, used);
+
+	cdma->stats.queue_depth++;
+	cdma->stats.queue_high_water = max(cdma->stats.queue_high_water,
+					   cdma->stats.queue_depth);
+
 	/* start timer on idle -> active transitions */
 	if (job->timeout && idle)
 		cdma_start_timer_locked(cdma, job);
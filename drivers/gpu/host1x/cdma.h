@@ -59,6 +59,33 @@ struct buffer_timeout {
 	int client;
 };
 
+/*
+ * Job latency histograms use log2 buckets of microseconds: bucket 0 counts
+ * latencies below 2 us, bucket n counts [2^n, 2^(n+1)) us and the last
+ * bucket collects everything above.
+ */
+#define HOST1X_LATENCY_BUCKETS	20
+
+struct host1x_latency_hist {
+	u64 count;
+	u64 total_us;
+	u64 max_us;
+	u32 buckets[HOST1X_LATENCY_BUCKETS];
+};
+
+struct host1x_job_stats {
+	struct host1x_latency_hist queue;	/* submit to CDMA kick */
+	struct host1x_latency_hist exec;	/* CDMA kick to completion */
+	struct host1x_latency_hist total;	/* submit to completion */
+};
+
+struct host1x_cdma_stats {
+	struct host1x_job_stats jobs;
+	unsigned int pb_high_water;	/* max push buffer slots in use */
+	unsigned int queue_depth;	/* jobs currently in the sync queue */
+	unsigned int queue_high_water;	/* max jobs in the sync queue */
+};
+
 enum cdma_event {
 	CDMA_EVENT_NONE,		/* not waiting for any event */
 	CDMA_EVENT_SYNC_QUEUE_EMPTY,	/* wait for empty sync queue */
@@ -76,6 +103,7 @@ struct host1x_cdma {
 	struct push_buffer push_buffer;	/* channel's push buffer */
 	struct list_head sync_queue;	/* job queue */
 	struct buffer_timeout timeout;	/* channel's timeout state/wq */
+	struct host1x_cdma_stats stats;	/* latency and occupancy stats */
 	bool running;
 	bool torndown;
 };
@@ -16,6 +16,7 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/math64.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 
@@ -118,6 +119,100 @@ static void show_all_no_fifo(struct host1x *host1x, struct output *o)
 		show_channels(ch, o, false);
 }
 
+static void show_latency_hist(struct output *o, const char *name,
+			      const struct host1x_latency_hist *hist)
+{
+	unsigned int i;
+
+	host1x_debug_output(o, "  %-5s count %llu avg %llu us max %llu us\n",
+			    name, hist->count,
+			    hist->count ? div64_u64(hist->total_us,
+						    hist->count) : 0,
+			    hist->max_us);
+
+	for (i = 0; i < HOST1X_LATENCY_BUCKETS; i++) {
+		if (!hist->buckets[i])
+			continue;
+
+		if (i == HOST1X_LATENCY_BUCKETS - 1)
+			host1x_debug_output(o, "    >= %u us: %u\n", 1U << i,
+					    hist->buckets[i]);
+		else
+			host1x_debug_output(o, "    < %u us: %u\n",
+					    2U << i, hist->buckets[i]);
+	}
+}
+
+static void show_job_stats(struct output *o,
+			   const struct host1x_job_stats *stats)
+{
+	show_latency_hist(o, "queue", &stats->queue);
+	show_latency_hist(o, "exec", &stats->exec);
+	show_latency_hist(o, "total", &stats->total);
+}
+
+static void show_latency(struct host1x *m, struct output *o)
+{
+	struct host1x_client_stats *cs;
+	struct host1x_job_stats stats;
+	struct host1x_channel *ch;
+	unsigned int i;
+
+	host1x_debug_output(o, "---- channels ----\n");
+
+	host1x_for_each_channel(m, ch) {
+		mutex_lock(&ch->reflock);
+
+		if (ch->refcount) {
+			struct host1x_cdma *cdma = &ch->cdma;
+
+			mutex_lock(&cdma->lock);
+			host1x_debug_output(o,
+				"%u-%s: pb high water %u/%u, queue depth %u high water %u\n",
+				ch->id, dev_name(ch->dev),
+				cdma->stats.pb_high_water,
+				cdma->push_buffer.size_bytes / 8 - 1,
+				cdma->stats.queue_depth,
+				cdma->stats.queue_high_water);
+			show_job_stats(o, &cdma->stats.jobs);
+			mutex_unlock(&cdma->lock);
+		}
+
+		mutex_unlock(&ch->reflock);
+	}
+
+	host1x_debug_output(o, "\n---- clients ----\n");
+
+	for (i = 0; i < HOST1X_NUM_CLIENT_STATS; i++) {
+		u32 class;
+
+		cs = &m->client_stats[i];
+
+		spin_lock(&m->stats_lock);
+		class = cs->class;
+		stats = cs->jobs;
+		spin_unlock(&m->stats_lock);
+
+		if (!class)
+			break;
+
+		host1x_debug_output(o, "class 0x%02x:\n", class);
+		show_job_stats(o, &stats);
+	}
+}
+
+static int host1x_debug_show_latency(struct seq_file *s, void *unused)
+{
+	struct output o = {
+		.fn = write_to_seqfile,
+		.ctx = s
+	};
+
+	show_latency(s->private, &o);
+
+	return 0;
+}
+
 static int host1x_debug_show_all(struct seq_file *s, void *unused)
 {
 	struct output o = {
@@ -166,6 +261,18 @@ static const struct file_operations host1x_debug_fops = {
 	.release = single_release,
 };
 
+static int host1x_debug_open_latency(struct inode *inode, struct file *file)
+{
+	return single_open(file, host1x_debug_show_latency, inode->i_private);
+}
+
+static const struct file_operations host1x_debug_latency_fops = {
+	.open = host1x_debug_open_latency,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void host1x_debugfs_init(struct host1x *host1x)
 {
 	struct dentry *de = debugfs_create_dir("tegra-host1x", NULL);
@@ -179,6 +286,8 @@ static void host1x_debugfs_init(struct host1x *host1x)
 	debugfs_create_file("status", S_IRUGO, de, host1x, &host1x_debug_fops);
 	debugfs_create_file("status_all", S_IRUGO, de, host1x,
 			    &host1x_debug_all_fops);
+	debugfs_create_file("latency", S_IRUGO, de, host1x,
+			    &host1x_debug_latency_fops);
 
 	debugfs_create_u32("trace_cmdbuf", S_IRUGO|S_IWUSR, de,
 			   &host1x_debug_trace_cmdbuf);
@@ -141,6 +141,7 @@ static int host1x_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	mutex_init(&host->devices_lock);
+	spin_lock_init(&host->stats_lock);
 	INIT_LIST_HEAD(&host->devices);
 	INIT_LIST_HEAD(&host->list);
 	host->dev = &pdev->dev;
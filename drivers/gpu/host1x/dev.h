@@ -99,6 +99,14 @@ struct host1x_info {
 	u64 dma_mask; /* mask of addressable memory */
 };
 
+/* number of distinct client classes tracked for job latency stats */
+#define HOST1X_NUM_CLIENT_STATS 8
+
+struct host1x_client_stats {
+	u32 class;
+	struct host1x_job_stats jobs;
+};
+
 struct host1x {
 	const struct host1x_info *info;
 
@@ -127,6 +135,9 @@ struct host1x {
 
 	struct dentry *debugfs;
 
+	spinlock_t stats_lock;
+	struct host1x_client_stats client_stats[HOST1X_NUM_CLIENT_STATS];
+
 	struct mutex devices_lock;
 	struct list_head devices;
 
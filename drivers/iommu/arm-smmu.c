@@ -1590,88 +1590,100 @@ static void arm_smmu_detach_dev(struct iommu_domain *domain, struct device *dev)
 	arm_smmu_domain_remove_master(smmu_domain, cfg);
 }
 
+/*
+ * Publish a new next-level table in @entry unless it has been populated
+ * in the meantime, so that mappings of disjoint ranges in the same domain
+ * can grow the tables concurrently without holding the domain lock.
+ * Returns false if somebody else won the race and the caller's table
+ * must be freed.
+ */
+static bool arm_smmu_install_table(struct arm_smmu_device *smmu,
+				   u64 *entry, u64 val)
+{
+	bool installed;
+
+	/* Ensure the table itself is visible before its entry can be */
+	wmb();
+	installed = !cmpxchg64(entry, 0, val);
+	arm_smmu_flush_pgtable(smmu, entry, sizeof(*entry));
+
+	return installed;
+}
+
 static void *arm_smmu_alloc_pgtable_page(struct arm_smmu_domain *domain, int lvl,
 					void * entry, unsigned long addr)
 {
 	struct arm_smmu_device *smmu = domain->smmu;
-	void * ret = NULL;
-	unsigned long flags;
 
 	pr_debug("Alloc for address %lx level: %d\n", addr, lvl);
 
-	spin_lock_irqsave(&domain->lock, flags);
-
 	if (lvl == 0) {
 #ifndef __PAGETABLE_PUD_FOLDED
 		pgd_t *pgd = (pgd_t *) entry;
+		pgd_t new = __pgd(0);
 		pud_t *pud;
 
-		if (!pgd_none(*pgd)) {
-			ret = pud_offset(pgd, adr);
-			goto unlock_ret;
-		}
-
-		pud = (pud_t *)get_zeroed_page(GFP_ATOMIC);
-		if (!pud)
-			goto unlock_ret;
+		if (pgd_none(READ_ONCE(*pgd))) {
+			pud = (pud_t *)get_zeroed_page(GFP_ATOMIC);
+			if (!pud)
+				return NULL;
 
-		arm_smmu_flush_pgtable(smmu, pud, PAGE_SIZE);
-		pgd_populate(NULL, pgd, pud);
-		arm_smmu_flush_pgtable(smmu, pgd, sizeof(*pgd));
+			arm_smmu_flush_pgtable(smmu, pud, PAGE_SIZE);
+			pgd_populate(NULL, &new, pud);
+			if (!arm_smmu_install_table(smmu, &pgd_val(*pgd),
+						    pgd_val(new)))
+				free_page((unsigned long)pud);
+		}
 
-		ret = pud + pud_index(addr);
-		goto unlock_ret;
+		return pud_offset(pgd, addr);
 #else
-		goto unlock_ret;
+		return NULL;
 #endif
 
 	} else if (lvl == 1) {
 #ifndef __PAGETABLE_PMD_FOLDED
 		pud_t *pud = (pud_t *) entry;
+		pud_t new = __pud(0);
 		pmd_t *pmd;
 
-		if (!pud_none(*pud)) {
-			ret = pmd_offset(pud, addr);
-			goto unlock_ret;
-		}
-
-		pmd = (pmd_t *) get_zeroed_page(GFP_ATOMIC);
-		if (!pmd)
-			goto unlock_ret;
+		if (pud_none(READ_ONCE(*pud))) {
+			pmd = (pmd_t *) get_zeroed_page(GFP_ATOMIC);
+			if (!pmd)
+				return NULL;
 
-		arm_smmu_flush_pgtable(smmu, pmd, PAGE_SIZE);
-		pud_populate(NULL, pud, pmd);
-		arm_smmu_flush_pgtable(smmu, pud, sizeof(*pud));
+			arm_smmu_flush_pgtable(smmu, pmd, PAGE_SIZE);
+			pud_populate(NULL, &new, pmd);
+			if (!arm_smmu_install_table(smmu, &pud_val(*pud),
+						    pud_val(new)))
+				free_page((unsigned long)pmd);
+		}
 
-		ret = pmd + pmd_index(addr);
-		goto unlock_ret;
+		return pmd_offset(pud, addr);
 #else
-		goto unlock_ret;
+		return NULL;
 #endif
 	} else if (lvl == 2) {
 		pmd_t *pmd = (pmd_t *) entry;
+		pmd_t new = __pmd(0);
 		pgtable_t table;
 
-		if (!pmd_none(*pmd)) {
-			ret = pmd_page_vaddr(*pmd) + pte_index(addr);
-			goto unlock_ret;
+		if (pmd_none(READ_ONCE(*pmd))) {
+			table = alloc_page(GFP_ATOMIC|__GFP_ZERO);
+			if (!table)
+				return NULL;
+
+			arm_smmu_flush_pgtable(smmu, page_address(table),
+					       PAGE_SIZE);
+			pmd_populate(NULL, &new, table);
+			if (!arm_smmu_install_table(smmu, &pmd_val(*pmd),
+						    pmd_val(new)))
+				__free_page(table);
 		}
 
-		table = alloc_page(GFP_ATOMIC|__GFP_ZERO);
-		if (!table)
-			goto unlock_ret;
-
-		arm_smmu_flush_pgtable(smmu, page_address(table), PAGE_SIZE);
-		pmd_populate(NULL, pmd, table);
-		arm_smmu_flush_pgtable(smmu, pmd, sizeof(*pmd));
-
-		ret = table;
-		goto unlock_ret;
+		return pmd_page_vaddr(*pmd) + pte_index(addr);
 	}
 
-unlock_ret:
-	spin_unlock_irqrestore(&domain->lock, flags);
-	return ret;
+	return NULL;
 }
 
 static int arm_smmu_alloc_init_pte(struct arm_smmu_domain *domain, pmd_t *pmd,
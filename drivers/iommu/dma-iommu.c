@@ -22,6 +22,7 @@
 
 #define pr_fmt(fmt)	"%s():%d: " fmt, __func__, __LINE__
 
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/dma-iommu.h>
 #include <linux/gfp.h>
@@ -29,9 +30,11 @@
 #include <linux/iommu.h>
 #include <linux/iova.h>
 #include <linux/irq.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
 #include <linux/pci.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/vmalloc.h>
 #include <linux/dma-contiguous.h>
 
@@ -53,6 +56,13 @@ struct iommu_dma_cookie {
 	spinlock_t		msi_lock;
 };
 
+/*
+ * Pages handed out by __iommu_dma_alloc_pages(), and how many of them came
+ * in chunks the IOMMU can map with a single block/section entry.
+ */
+static atomic64_t iommu_dma_alloc_pages_total = ATOMIC64_INIT(0);
+static atomic64_t iommu_dma_alloc_pages_block = ATOMIC64_INIT(0);
+
 static inline struct iova_domain *cookie_iovad(struct iommu_domain *domain)
 {
 	return &((struct iommu_dma_cookie *)domain->iova_cookie)->iovad;
@@ -368,6 +378,7 @@ static struct page **__iommu_dma_alloc_pages(unsigned int count,
 {
 	struct page **pages;
 	unsigned int i = 0, array_size = count * sizeof(*pages);
+	unsigned int max_order = MAX_ORDER - 1, blocks = 0;
 
 	order_mask &= (2U << MAX_ORDER) - 1;
 	if (!order_mask)
@@ -387,24 +398,50 @@ static struct page **__iommu_dma_alloc_pages(unsigned int count,
 	gfp |= __GFP_NOWARN;
 
 	while (count) {
-		int j, order = __fls(count);
+		unsigned int order = min_t(unsigned int, __fls(count), max_order);
+		unsigned long mask = order_mask & ((2UL << order) - 1);
+		struct page *page;
+		int j;
 
-		pages[i] = alloc_pages(gfp, order);
-		while (!pages[i] && order)
-			pages[i] = alloc_pages(gfp, --order);
-		if (!pages[i])
-			goto error;
+		/*
+		 * Go for the largest size the IOMMU can map with a single
+		 * entry first, without trying too hard. Once an order has
+		 * failed, never go back up: keeping chunk sizes non-increasing
+		 * means every chunk sits at an offset that is a multiple of its
+		 * own size, so it lands on a matching IOVA boundary too.
+		 */
+		if (mask & ~1UL) {
+			order = __fls(mask);
+			page = alloc_pages(gfp | __GFP_NORETRY, order);
+			if (!page) {
+				order_mask &= ~(1UL << order);
+				max_order = order - 1;
+				continue;
+			}
+			blocks += 1 << order;
+		} else {
+			page = alloc_pages(gfp, order);
+			while (!page && order)
+				page = alloc_pages(gfp, --order);
+			if (!page)
+				goto error;
+			max_order = order;
+		}
 
+		pages[i] = page;
 		if (order) {
-			split_page(pages[i], order);
+			split_page(page, order);
 			j = 1 << order;
 			while (--j)
-				pages[i + j] = pages[i] + j;
+				pages[i + j] = page + j;
 		}
 		i += 1 << order;
 		count -= 1 << order;
 	}
 
+	atomic64_add(i, &iommu_dma_alloc_pages_total);
+	atomic64_add(blocks, &iommu_dma_alloc_pages_block);
+
 	return pages;
 error:
 	while (i--)
@@ -901,3 +938,43 @@ void iommu_dma_map_msi_msg(int irq, struct msi_msg *msg)
 		msg->address_lo += lower_32_bits(msi_page->iova);
 	}
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int iommu_dma_alloc_stats_show(struct seq_file *s, void *data)
+{
+	u64 total = atomic64_read(&iommu_dma_alloc_pages_total);
+	u64 block = atomic64_read(&iommu_dma_alloc_pages_block);
+
+	seq_printf(s, "pages allocated:  %llu\n", total);
+	seq_printf(s, "pages in blocks:  %llu\n", block);
+	seq_printf(s, "block ratio:      %llu%%\n",
+		   total ? div64_u64(block * 100, total) : 0);
+	return 0;
+}
+
+static int iommu_dma_alloc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, iommu_dma_alloc_stats_show, inode->i_private);
+}
+
+static const struct file_operations iommu_dma_alloc_stats_fops = {
+	.open		= iommu_dma_alloc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init iommu_dma_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("dma-iommu", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_file("alloc_stats", S_IRUGO, root, NULL,
+			    &iommu_dma_alloc_stats_fops);
+	return 0;
+}
+late_initcall(iommu_dma_debugfs_init);
+#endif
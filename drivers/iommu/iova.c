@@ -23,6 +23,9 @@
 #include <linux/smp.h>
 #include <linux/bitops.h>
 #include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/topology.h>
 
 static bool iova_rcache_insert(struct iova_domain *iovad,
 			       unsigned long pfn,
@@ -32,6 +35,9 @@ static unsigned long iova_rcache_get(struct iova_domain *iovad,
 				     unsigned long limit_pfn);
 static void init_iova_rcaches(struct iova_domain *iovad);
 static void free_iova_rcaches(struct iova_domain *iovad);
+static void free_global_cached_iovas(struct iova_domain *iovad);
+static void iova_debugfs_init(void);
+static void iova_debugfs_exit(void);
 
 void
 init_iova_domain(struct iova_domain *iovad, unsigned long granule,
@@ -251,6 +257,7 @@ int iova_cache_get(void)
 			printk(KERN_ERR "Couldn't create iova cache\n");
 			return -ENOMEM;
 		}
+		iova_debugfs_init();
 	}
 
 	iova_cache_users++;
@@ -268,8 +275,10 @@ void iova_cache_put(void)
 		return;
 	}
 	iova_cache_users--;
-	if (!iova_cache_users)
+	if (!iova_cache_users) {
+		iova_debugfs_exit();
 		kmem_cache_destroy(iova_cache);
+	}
 	mutex_unlock(&iova_cache_mutex);
 }
 EXPORT_SYMBOL_GPL(iova_cache_put);
@@ -442,6 +451,7 @@ alloc_iova_fast(struct iova_domain *iovad, unsigned long size,
 		flushed_rcache = true;
 		for_each_online_cpu(cpu)
 			free_cpu_cached_iovas(cpu, iovad);
+		free_global_cached_iovas(iovad);
 		goto retry;
 	}
 
@@ -670,6 +680,52 @@ struct iova_cpu_rcache {
 	struct iova_magazine *prev;
 };
 
+/*
+ * Full magazines are traded through a depot per CPU cluster, so that CPUs
+ * sharing a cache mostly hand IOVAs to each other and only go to another
+ * cluster's depot when their own runs dry.
+ */
+struct iova_depot {
+	spinlock_t lock;
+	unsigned long depot_size;
+	struct iova_magazine *depot[MAX_GLOBAL_MAGS];
+} ____cacheline_aligned_in_smp;
+
+struct iova_rcache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long inserts;
+	unsigned long overflows;
+};
+
+static DEFINE_PER_CPU(struct iova_rcache_stats[IOVA_RANGE_CACHE_MAX_SIZE],
+		      iova_rcache_stats);
+
+static unsigned int iova_nr_depots(void)
+{
+	unsigned int cpu, nr = 1;
+
+	for_each_possible_cpu(cpu) {
+		int id = topology_physical_package_id(cpu);
+
+		if (id >= 0 && id + 1 > nr)
+			nr = id + 1;
+	}
+
+	return nr;
+}
+
+static struct iova_depot *iova_cpu_depot(struct iova_rcache *rcache,
+					 unsigned int cpu)
+{
+	int id = topology_physical_package_id(cpu);
+
+	if (id < 0 || id >= rcache->nr_depots)
+		id = 0;
+
+	return &rcache->depots[id];
+}
+
 static struct iova_magazine *iova_magazine_alloc(gfp_t flags)
 {
 	return kzalloc(sizeof(struct iova_magazine), flags);
@@ -703,9 +759,10 @@ iova_magazine_free_pfns(struct iova_magazine *mag, struct iova_domain *iovad)
 	mag->size = 0;
 }
 
-static bool iova_magazine_full(struct iova_magazine *mag)
+static bool iova_magazine_full(struct iova_rcache *rcache,
+			       struct iova_magazine *mag)
 {
-	return (mag && mag->size == IOVA_MAG_SIZE);
+	return (mag && mag->size == rcache->mag_size);
 }
 
 static bool iova_magazine_empty(struct iova_magazine *mag)
@@ -724,24 +781,51 @@ static unsigned long iova_magazine_pop(struct iova_magazine *mag,
 	return mag->pfns[--mag->size];
 }
 
-static void iova_magazine_push(struct iova_magazine *mag, unsigned long pfn)
+static void iova_magazine_push(struct iova_rcache *rcache,
+			       struct iova_magazine *mag, unsigned long pfn)
 {
-	BUG_ON(iova_magazine_full(mag));
+	BUG_ON(iova_magazine_full(rcache, mag));
 
 	mag->pfns[mag->size++] = pfn;
 }
 
 static void init_iova_rcaches(struct iova_domain *iovad)
 {
+	unsigned int nr_depots = iova_nr_depots();
 	struct iova_cpu_rcache *cpu_rcache;
 	struct iova_rcache *rcache;
 	unsigned int cpu;
-	int i;
+	int i, j;
 
 	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
 		rcache = &iovad->rcaches[i];
-		spin_lock_init(&rcache->lock);
-		rcache->depot_size = 0;
+
+		/*
+		 * Large ranges would otherwise pin a lot of IOVA space in
+		 * the caches: halve the magazine for every size doubling
+		 * past IOVA_RANGE_CACHE_LARGE_SIZE, so that a magazine never
+		 * holds more than 16 * 2^IOVA_RANGE_CACHE_LARGE_SIZE pages,
+		 * and keep the depots correspondingly short.
+		 */
+		if (i < IOVA_RANGE_CACHE_LARGE_SIZE) {
+			rcache->mag_size = IOVA_MAG_SIZE;
+			rcache->depot_max = MAX_GLOBAL_MAGS;
+		} else {
+			rcache->mag_size =
+				max(16UL >> (i - IOVA_RANGE_CACHE_LARGE_SIZE),
+				    1UL);
+			rcache->depot_max = 2;
+		}
+
+		rcache->nr_depots = 0;
+		rcache->depots = kcalloc(nr_depots, sizeof(*rcache->depots),
+					 GFP_KERNEL);
+		if (!WARN_ON(!rcache->depots)) {
+			rcache->nr_depots = nr_depots;
+			for (j = 0; j < nr_depots; j++)
+				spin_lock_init(&rcache->depots[j].lock);
+		}
+
 		rcache->cpu_rcaches = __alloc_percpu(sizeof(*cpu_rcache), cache_line_size());
 		if (WARN_ON(!rcache->cpu_rcaches))
 			continue;
@@ -772,23 +856,32 @@ static bool __iova_rcache_insert(struct iova_domain *iovad,
 	cpu_rcache = raw_cpu_ptr(rcache->cpu_rcaches);
 	spin_lock_irqsave(&cpu_rcache->lock, flags);
 
-	if (!iova_magazine_full(cpu_rcache->loaded)) {
+	if (!iova_magazine_full(rcache, cpu_rcache->loaded)) {
 		can_insert = true;
-	} else if (!iova_magazine_full(cpu_rcache->prev)) {
+	} else if (!iova_magazine_full(rcache, cpu_rcache->prev)) {
 		swap(cpu_rcache->prev, cpu_rcache->loaded);
 		can_insert = true;
 	} else {
 		struct iova_magazine *new_mag = iova_magazine_alloc(GFP_ATOMIC);
 
 		if (new_mag) {
-			spin_lock(&rcache->lock);
-			if (rcache->depot_size < MAX_GLOBAL_MAGS) {
-				rcache->depot[rcache->depot_size++] =
-						cpu_rcache->loaded;
+			struct iova_depot *depot = NULL;
+
+			if (rcache->nr_depots)
+				depot = iova_cpu_depot(rcache,
+						       smp_processor_id());
+
+			if (depot) {
+				spin_lock(&depot->lock);
+				if (depot->depot_size < rcache->depot_max)
+					depot->depot[depot->depot_size++] =
+							cpu_rcache->loaded;
+				else
+					mag_to_free = cpu_rcache->loaded;
+				spin_unlock(&depot->lock);
 			} else {
 				mag_to_free = cpu_rcache->loaded;
 			}
-			spin_unlock(&rcache->lock);
 
 			cpu_rcache->loaded = new_mag;
 			can_insert = true;
@@ -796,7 +889,7 @@ static bool __iova_rcache_insert(struct iova_domain *iovad,
 	}
 
 	if (can_insert)
-		iova_magazine_push(cpu_rcache->loaded, iova_pfn);
+		iova_magazine_push(rcache, cpu_rcache->loaded, iova_pfn);
 
 	spin_unlock_irqrestore(&cpu_rcache->lock, flags);
 
@@ -812,11 +905,46 @@ static bool iova_rcache_insert(struct iova_domain *iovad, unsigned long pfn,
 			       unsigned long size)
 {
 	unsigned int log_size = order_base_2(size);
+	bool inserted;
 
 	if (log_size >= IOVA_RANGE_CACHE_MAX_SIZE)
 		return false;
 
-	return __iova_rcache_insert(iovad, &iovad->rcaches[log_size], pfn);
+	/*
+	 * Large ranges are mostly handed out to size-aligned requests, which
+	 * rely on that alignment for block mappings, so don't let anything
+	 * else into their cache.
+	 */
+	if (log_size >= IOVA_RANGE_CACHE_LARGE_SIZE && !IS_ALIGNED(pfn, size))
+		return false;
+
+	inserted = __iova_rcache_insert(iovad, &iovad->rcaches[log_size], pfn);
+	if (inserted)
+		this_cpu_inc(iova_rcache_stats[log_size].inserts);
+	else
+		this_cpu_inc(iova_rcache_stats[log_size].overflows);
+
+	return inserted;
+}
+
+/*
+ * Pull a full magazine out of 'depot' into 'cpu_rcache'.  Called with the
+ * cpu_rcache lock held.
+ */
+static bool iova_depot_get(struct iova_depot *depot,
+			   struct iova_cpu_rcache *cpu_rcache)
+{
+	bool has_pfn = false;
+
+	spin_lock(&depot->lock);
+	if (depot->depot_size > 0) {
+		iova_magazine_free(cpu_rcache->loaded);
+		cpu_rcache->loaded = depot->depot[--depot->depot_size];
+		has_pfn = true;
+	}
+	spin_unlock(&depot->lock);
+
+	return has_pfn;
 }
 
 /*
@@ -840,14 +968,17 @@ static unsigned long __iova_rcache_get(struct iova_rcache *rcache,
 	} else if (!iova_magazine_empty(cpu_rcache->prev)) {
 		swap(cpu_rcache->prev, cpu_rcache->loaded);
 		has_pfn = true;
-	} else {
-		spin_lock(&rcache->lock);
-		if (rcache->depot_size > 0) {
-			iova_magazine_free(cpu_rcache->loaded);
-			cpu_rcache->loaded = rcache->depot[--rcache->depot_size];
-			has_pfn = true;
-		}
-		spin_unlock(&rcache->lock);
+	} else if (rcache->nr_depots) {
+		struct iova_depot *local;
+		unsigned int i;
+
+		/* Prefer our own cluster, then steal from the others */
+		local = iova_cpu_depot(rcache, smp_processor_id());
+		has_pfn = iova_depot_get(local, cpu_rcache);
+		for (i = 0; !has_pfn && i < rcache->nr_depots; i++)
+			if (&rcache->depots[i] != local)
+				has_pfn = iova_depot_get(&rcache->depots[i],
+							 cpu_rcache);
 	}
 
 	if (has_pfn)
@@ -868,11 +999,18 @@ static unsigned long iova_rcache_get(struct iova_domain *iovad,
 				     unsigned long limit_pfn)
 {
 	unsigned int log_size = order_base_2(size);
+	unsigned long iova_pfn;
 
 	if (log_size >= IOVA_RANGE_CACHE_MAX_SIZE)
 		return 0;
 
-	return __iova_rcache_get(&iovad->rcaches[log_size], limit_pfn);
+	iova_pfn = __iova_rcache_get(&iovad->rcaches[log_size], limit_pfn);
+	if (iova_pfn)
+		this_cpu_inc(iova_rcache_stats[log_size].hits);
+	else
+		this_cpu_inc(iova_rcache_stats[log_size].misses);
+
+	return iova_pfn;
 }
 
 /*
@@ -895,27 +1033,50 @@ static void free_cpu_iova_rcache(unsigned int cpu, struct iova_domain *iovad,
 	spin_unlock_irqrestore(&cpu_rcache->lock, flags);
 }
 
+/*
+ * Return all magazines held in 'rcache''s depots to the rbtree, and free
+ * the depots themselves if 'free_depots' is set.
+ */
+static void free_iova_depots(struct iova_domain *iovad,
+			     struct iova_rcache *rcache, bool free_depots)
+{
+	struct iova_depot *depot;
+	unsigned long flags;
+	int i, j;
+
+	for (i = 0; i < rcache->nr_depots; ++i) {
+		depot = &rcache->depots[i];
+		spin_lock_irqsave(&depot->lock, flags);
+		for (j = 0; j < depot->depot_size; ++j) {
+			iova_magazine_free_pfns(depot->depot[j], iovad);
+			iova_magazine_free(depot->depot[j]);
+		}
+		depot->depot_size = 0;
+		spin_unlock_irqrestore(&depot->lock, flags);
+	}
+
+	if (free_depots) {
+		kfree(rcache->depots);
+		rcache->depots = NULL;
+		rcache->nr_depots = 0;
+	}
+}
+
 /*
  * free rcache data structures.
  */
 static void free_iova_rcaches(struct iova_domain *iovad)
 {
 	struct iova_rcache *rcache;
-	unsigned long flags;
 	unsigned int cpu;
-	int i, j;
+	int i;
 
 	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
 		rcache = &iovad->rcaches[i];
 		for_each_possible_cpu(cpu)
 			free_cpu_iova_rcache(cpu, iovad, rcache);
-		spin_lock_irqsave(&rcache->lock, flags);
 		free_percpu(rcache->cpu_rcaches);
-		for (j = 0; j < rcache->depot_size; ++j) {
-			iova_magazine_free_pfns(rcache->depot[j], iovad);
-			iova_magazine_free(rcache->depot[j]);
-		}
-		spin_unlock_irqrestore(&rcache->lock, flags);
+		free_iova_depots(iovad, rcache, true);
 	}
 }
 
@@ -939,5 +1100,84 @@ void free_cpu_cached_iovas(unsigned int cpu, struct iova_domain *iovad)
 	}
 }
 
+/*
+ * free all the IOVA ranges parked in the depots
+ */
+static void free_global_cached_iovas(struct iova_domain *iovad)
+{
+	int i;
+
+	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i)
+		free_iova_depots(iovad, &iovad->rcaches[i], false);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *iova_debugfs_root;
+
+static int iova_rcache_stats_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	seq_printf(s, "%-8s %12s %12s %12s %12s\n", "pages",
+		   "hits", "misses", "inserts", "overflows");
+
+	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+		struct iova_rcache_stats sum = { 0 };
+		unsigned int cpu;
+
+		for_each_possible_cpu(cpu) {
+			struct iova_rcache_stats *st =
+				&per_cpu(iova_rcache_stats, cpu)[i];
+
+			sum.hits += st->hits;
+			sum.misses += st->misses;
+			sum.inserts += st->inserts;
+			sum.overflows += st->overflows;
+		}
+
+		seq_printf(s, "%-8lu %12lu %12lu %12lu %12lu\n", 1UL << i,
+			   sum.hits, sum.misses, sum.inserts, sum.overflows);
+	}
+
+	return 0;
+}
+
+static int iova_rcache_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, iova_rcache_stats_show, inode->i_private);
+}
+
+static const struct file_operations iova_rcache_stats_fops = {
+	.open		= iova_rcache_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void iova_debugfs_init(void)
+{
+	iova_debugfs_root = debugfs_create_dir("iova", NULL);
+	if (!iova_debugfs_root)
+		return;
+
+	debugfs_create_file("rcache_stats", S_IRUGO, iova_debugfs_root, NULL,
+			    &iova_rcache_stats_fops);
+}
+
+static void iova_debugfs_exit(void)
+{
+	debugfs_remove_recursive(iova_debugfs_root);
+	iova_debugfs_root = NULL;
+}
+#else
+static void iova_debugfs_init(void)
+{
+}
+
+static void iova_debugfs_exit(void)
+{
+}
+#endif
+
 MODULE_AUTHOR("Anil S Keshavamurthy <anil.s.keshavamurthy@intel.com>");
 MODULE_LICENSE("GPL");
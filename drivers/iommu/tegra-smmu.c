@@ -518,7 +518,8 @@ static void flush_ptc_and_tlb_range_default(struct smmu_device *smmu,
 	while (iova < end) {
 		int i;
 
-		smmu_flush_ptc(smmu, pte, page);
+		/* posted writes, the read-back below orders all of them */
+		__smmu_flush_ptc(smmu, pte, page);
 		pte += smmu->ptc_cache_line / sizeof(*pte);
 
 		for (i = 0; i < ptc_iova_line / tlb_iova_line; i++) {
@@ -798,14 +799,119 @@ static int alloc_pdir(struct smmu_as *as)
 	return err;
 }
 
+/*
+ * Record a PDE vacated by unmap, to be flushed at the next smmu_iotlb_sync().
+ * Must be called with as->lock held.
+ */
+static void smmu_iotlb_pde_add(struct smmu_as *as, int pdn)
+{
+	if (!__test_and_set_bit(pdn, as->gather.vacated))
+		as->gather.nr_vacated++;
+}
+
+/*
+ * Detach an emptied page table from the page directory. The page is only
+ * released by smmu_iotlb_sync() once the PTC and TLB have been flushed.
+ */
+static void free_ptbl_deferred(struct smmu_as *as, dma_addr_t iova)
+{
+	int pdn = SMMU_ADDR_TO_PDN(iova);
+	u32 *pdir = (u32 *)page_address(as->pdir_page);
+
+	if (pdir[pdn] == _PDE_VACANT(pdn))
+		return;
+
+	if (pdir[pdn] & _PDE_NEXT)
+		list_add(&SMMU_EX_PTBL_PAGE(pdir[pdn])->lru,
+			 &as->gather.freelist);
+
+	pdir[pdn] = _PDE_VACANT(pdn);
+	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
+	smmu_iotlb_pde_add(as, pdn);
+}
+
+/*
+ * Record an unmapped IOVA range whose PTC and TLB entries must be
+ * invalidated at the next smmu_iotlb_sync().
+ * Must be called with as->lock held.
+ */
+static void smmu_iotlb_range_add(struct smmu_as *as, dma_addr_t iova,
+				 size_t bytes)
+{
+	struct smmu_iotlb_gather *gather = &as->gather;
+
+	if (!gather->nr_ranges) {
+		gather->start = iova;
+		gather->end = iova + bytes;
+	} else {
+		gather->start = min_t(dma_addr_t, gather->start, iova);
+		gather->end = max_t(dma_addr_t, gather->end, iova + bytes);
+	}
+
+	gather->nr_ranges++;
+	atomic64_inc(&as->smmu->flush_requested);
+}
+
+/*
+ * Flush all ranges gathered since the last sync. Each vacated PDE gets
+ * its own flush first, then the ranges are covered by one ranged PTC/TLB
+ * flush when they fall within one page table, and by a full PTC plus
+ * per-ASID TLB flush otherwise. Every flush issued is counted in
+ * flush_issued.
+ * Must be called with as->lock held.
+ */
+static void smmu_iotlb_sync(struct smmu_as *as)
+{
+	struct smmu_iotlb_gather *gather = &as->gather;
+	u32 *pdir = page_address(as->pdir_page);
+	int pdn = SMMU_ADDR_TO_PDN(gather->start);
+	size_t count = (gather->end - gather->start) >> PAGE_SHIFT;
+	struct page *page, *tmp;
+	unsigned int i;
+
+	if (!gather->nr_ranges)
+		return;
+
+	/* Drop the section entries of vacated PDEs before their tables go. */
+	if (gather->nr_vacated) {
+		for_each_set_bit(i, gather->vacated, SMMU_PDIR_COUNT) {
+			flush_ptc_and_tlb(as->smmu, as, SMMU_PDN_TO_ADDR(i),
+					  &pdir[i], as->pdir_page, 1);
+			atomic64_inc(&as->smmu->flush_issued);
+		}
+		bitmap_zero(gather->vacated, SMMU_PDIR_COUNT);
+		gather->nr_vacated = 0;
+	}
+
+	if (pdn == SMMU_ADDR_TO_PDN(gather->end - 1) &&
+	    (pdir[pdn] & _PDE_NEXT) &&
+	    count <= smmu_flush_all_th_unmap_pages) {
+		u32 *ptbl;
+
+		page = SMMU_EX_PTBL_PAGE(pdir[pdn]);
+		ptbl = page_address(page);
+		flush_ptc_and_tlb_range(as->smmu, as, gather->start,
+					&ptbl[SMMU_ADDR_TO_PTN(gather->start)],
+					page, count);
+	} else {
+		flush_ptc_and_tlb_as(as, gather->start, gather->end);
+	}
+
+	atomic64_inc(&as->smmu->flush_issued);
+
+	list_for_each_entry_safe(page, tmp, &gather->freelist, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+
+	gather->nr_ranges = 0;
+}
+
 static size_t __smmu_iommu_unmap_pages(struct smmu_as *as, dma_addr_t iova,
 				       size_t bytes)
 {
 	int total = bytes >> PAGE_SHIFT;
 	u32 *pdir = page_address(as->pdir_page);
-	struct smmu_device *smmu = as->smmu;
-	unsigned long iova_base = iova;
-	bool flush_all = (total > smmu_flush_all_th_unmap_pages) ? true : false;
 
 	while (total > 0) {
 		int ptn = SMMU_ADDR_TO_PTN(iova);
@@ -840,16 +946,15 @@ static size_t __smmu_iommu_unmap_pages(struct smmu_as *as, dma_addr_t iova,
 						(u64)(iova + i * PAGE_SIZE));
 			}
 			*rest -= count;
+			as->nr_page_maps -= count;
 			if (*rest) {
 				memset(pte, 0, pte_bytes);
 				FLUSH_CPU_DCACHE(pte, page, pte_bytes);
 			} else {
-				free_ptbl(as, iova, !flush_all);
+				free_ptbl_deferred(as, iova);
 			}
 
-			if (!flush_all)
-				flush_ptc_and_tlb_range(smmu, as, iova, pte,
-							page, count);
+			smmu_iotlb_range_add(as, iova, count * PAGE_SIZE);
 		}
 
 		iova += PAGE_SIZE * count;
@@ -857,9 +962,6 @@ static size_t __smmu_iommu_unmap_pages(struct smmu_as *as, dma_addr_t iova,
 	}
 
 	bytes -= total << PAGE_SHIFT;
-	if (bytes && flush_all)
-		flush_ptc_and_tlb_as(as, iova_base,
-				     iova_base + bytes);
 
 	return bytes;
 }
@@ -870,10 +972,12 @@ static size_t __smmu_iommu_unmap_largepage(struct smmu_as *as, dma_addr_t iova)
 	u32 *pdir = (u32 *)page_address(as->pdir_page);
 
 	pdir[pdn] = _PDE_VACANT(pdn);
+	as->nr_section_maps--;
 	trace_smmu_set_pte(as->asid, iova, 0, SZ_4M, 0);
 
 	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
-	flush_ptc_and_tlb(as->smmu, as, iova, &pdir[pdn], as->pdir_page, 1);
+	smmu_iotlb_pde_add(as, pdn);
+	smmu_iotlb_range_add(as, iova, SZ_4M);
 	return SZ_4M;
 }
 
@@ -910,6 +1014,7 @@ static int __smmu_iommu_map_pfn_default(struct smmu_as *as, dma_addr_t iova,
 		attrs &= ~_READABLE;
 
 	*pte = SMMU_PFN_TO_PTE(pfn, attrs);
+	as->nr_page_maps++;
 	trace_smmu_set_pte(as->asid, iova, PFN_PHYS(pfn), PAGE_SIZE, attrs);
 
 	FLUSH_CPU_DCACHE(pte, page, sizeof(*pte));
@@ -955,6 +1060,7 @@ static int __smmu_iommu_map_largepage_default(struct smmu_as *as, dma_addr_t iov
 		attrs &= ~_READABLE;
 
 	pdir[pdn] = pa >> SMMU_PDE_SHIFT | attrs;
+	as->nr_section_maps++;
 	trace_smmu_set_pte(as->asid, iova, pa, SZ_4M, attrs);
 
 	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
@@ -993,18 +1099,61 @@ static int smmu_iommu_map(struct iommu_domain *domain, unsigned long iova,
 	return err;
 }
 
+/*
+ * Map a physically contiguous run, using 4MB sections wherever both the
+ * IOVA and the physical address are suitably aligned.
+ */
+static int __smmu_iommu_map_run(struct iommu_domain *domain,
+				struct smmu_as *as, unsigned long *iova,
+				phys_addr_t paddr, size_t size, ulong prot,
+				bool flush)
+{
+	int (*fn)(struct smmu_as *, dma_addr_t, phys_addr_t, ulong, bool);
+	unsigned long flags;
+	int ret;
+
+	while (size) {
+		size_t pgsize = iommu_pgsize(domain, *iova | paddr, size);
+
+#if IS_ENABLED(CONFIG_TEGRA_IOMMU_SMMU_NO4MB)
+		WARN_ON_ONCE(pgsize == SZ_4M);
+#endif
+		switch (pgsize) {
+		case SZ_4K:
+			fn = __smmu_iommu_map_page;
+			break;
+		case SZ_4M:
+			fn = __smmu_iommu_map_largepage;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		spin_lock_irqsave(&as->lock, flags);
+		ret = fn(as, *iova, paddr, prot, flush);
+		spin_unlock_irqrestore(&as->lock, flags);
+		if (ret)
+			return ret;
+
+		*iova += pgsize;
+		paddr += pgsize;
+		size -= pgsize;
+	}
+
+	return 0;
+}
+
 static size_t smmu_iommu_map_sg(struct iommu_domain *domain, unsigned long iova,
 				struct scatterlist *sg, uint nents, ulong prot)
 {
-	int (*fn)(struct smmu_as *, dma_addr_t, phys_addr_t, ulong, bool);
 	unsigned int min_pagesz = 1 << __ffs(domain->pgsize_bitmap);
 	struct smmu_as *as = domain_to_as(domain, iova);
 	unsigned long orig_iova = iova, npages;
-	size_t total_length = 0;
+	size_t total_length = 0, run_size = 0;
+	phys_addr_t run_paddr = 0;
 	struct scatterlist *s;
 	unsigned int i;
 	bool flush_all;
-	int ret;
 
 	if (!as) {
 		pr_err("domain_to_as failed!\n");
@@ -1018,47 +1167,39 @@ static size_t smmu_iommu_map_sg(struct iommu_domain *domain, unsigned long iova,
 	npages = total_length >> SMMU_PAGE_SHIFT;
 	flush_all = npages > smmu_flush_all_th_map_pages;
 
+	/*
+	 * Coalesce physically contiguous segments into runs before mapping,
+	 * so that buffers built from many small segments can still be mapped
+	 * with 4MB sections where the run is large and aligned enough.
+	 */
 	for_each_sg(sg, s, nents, i) {
 		phys_addr_t paddr = page_to_phys(sg_page(s)) + s->offset;
-		unsigned long merge = iova | paddr;
 		size_t size = s->length;
 
 		/* Make sure everything is aligned to the min page size */
 		if (!IS_ALIGNED(s->offset, min_pagesz) ||
-		    !IS_ALIGNED(merge | size, min_pagesz))
+		    !IS_ALIGNED(paddr | size, min_pagesz))
 			goto out_err;
 
-		while (size) {
-			size_t pgsize = iommu_pgsize(domain, merge, size);
-			unsigned long flags;
-
-#if IS_ENABLED(CONFIG_TEGRA_IOMMU_SMMU_NO4MB)
-			WARN_ON_ONCE(pgsize == SZ_4M);
-#endif
-			switch (pgsize) {
-			case SZ_4K:
-				fn = __smmu_iommu_map_page;
-				break;
-			case SZ_4M:
-				fn = __smmu_iommu_map_largepage;
-				break;
-			default:
-				goto out_err;
-			}
+		if (run_size && paddr == run_paddr + run_size) {
+			run_size += size;
+			continue;
+		}
 
-			spin_lock_irqsave(&as->lock, flags);
-			/* Note that we may flush_all at the end */
-			ret = fn(as, iova, paddr, prot, !flush_all);
-			spin_unlock_irqrestore(&as->lock, flags);
-			if (ret)
-				goto out_err;
+		/* Note that we may flush_all at the end */
+		if (run_size && __smmu_iommu_map_run(domain, as, &iova,
+						     run_paddr, run_size, prot,
+						     !flush_all))
+			goto out_err;
 
-			iova += pgsize;
-			paddr += pgsize;
-			size -= pgsize;
-		}
+		run_paddr = paddr;
+		run_size = size;
 	}
 
+	if (run_size && __smmu_iommu_map_run(domain, as, &iova, run_paddr,
+					     run_size, prot, !flush_all))
+		goto out_err;
+
 	if (flush_all)
 		flush_ptc_and_tlb_as(as, orig_iova, iova);
 
@@ -1099,6 +1240,9 @@ static int __smmu_iommu_remap_largepage(struct smmu_as *as, dma_addr_t iova)
 		*(pte + i) = SMMU_PFN_TO_PTE(pfn + i, as->pte_attr);
 	FLUSH_CPU_DCACHE(pte, page, SMMU_PTBL_SIZE);
 
+	as->nr_section_maps--;
+	as->nr_page_maps += SMMU_PTBL_COUNT;
+
 	/* Update pde */
 	pdir[pdn] = SMMU_MK_PDE(page, as->pde_attr | _PDE_NEXT);
 	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof(pdir[pdn]));
@@ -1147,6 +1291,7 @@ static size_t smmu_iommu_unmap(struct iommu_domain *domain, unsigned long iova,
 
 	spin_lock_irqsave(&as->lock, flags);
 	unmapped = __smmu_iommu_unmap(as, iova, bytes);
+	smmu_iotlb_sync(as);
 	spin_unlock_irqrestore(&as->lock, flags);
 	return unmapped;
 }
@@ -1251,6 +1396,10 @@ static void debugfs_create_as(struct smmu_as *as)
 			    as, &smmu_iova2pa_fops);
 	debugfs_create_file("iova_dump", S_IRUSR, as->debugfs_root,
 			    as, &smmu_iovadump_fops);
+	debugfs_create_u32("section_maps", S_IRUSR, as->debugfs_root,
+			   &as->nr_section_maps);
+	debugfs_create_u32("page_maps", S_IRUSR, as->debugfs_root,
+			   &as->nr_page_maps);
 }
 
 static struct smmu_as *smmu_as_alloc_default(void)
@@ -1691,6 +1840,9 @@ static void smmu_stats_update(struct smmu_debugfs_info *info)
 		lo = cur;
 		info->val[i] = (u64)hi << 32 | lo;
 	}
+
+	info->flush[0] = atomic64_read(&smmu->flush_requested);
+	info->flush[1] = atomic64_read(&smmu->flush_issued);
 }
 
 static void smmu_stats_timer_fn(unsigned long data)
@@ -1777,6 +1929,8 @@ static int smmu_debugfs_stats_show(struct seq_file *s, void *v)
 
 	smmu_stats_update(info);
 	seq_printf(s, "hit:%016llx miss:%016llx\n", info->val[0], info->val[1]);
+	seq_printf(s, "unmap flush requested:%llu issued:%llu\n",
+		   info->flush[0], info->flush[1]);
 	return 0;
 }
 
@@ -2317,6 +2471,7 @@ static int tegra_smmu_probe(struct platform_device *pdev)
 		spin_lock_init(&as->lock);
 		spin_lock_init(&as->client_lock);
 		INIT_LIST_HEAD(&as->client);
+		INIT_LIST_HEAD(&as->gather.freelist);
 	}
 	spin_lock_init(&smmu->lock);
 	spin_lock_init(&smmu->ptc_lock);
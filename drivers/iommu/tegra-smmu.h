@@ -191,6 +191,21 @@ struct smmu_client {
 	struct dentry           *as_link[MAX_AS_PER_DEV];
 };
 
+/*
+ * TLB invalidation deferred by unmap until the next sync point. Page
+ * tables emptied by the unmap are only freed after the flush, since the
+ * PTC may still hold references to them. PDEs vacated by the unmap are
+ * flushed one by one, as a ranged flush skips vacant PDEs.
+ */
+struct smmu_iotlb_gather {
+	dma_addr_t              start;
+	dma_addr_t              end;
+	unsigned int            nr_ranges;
+	struct list_head        freelist;
+	unsigned int            nr_vacated;
+	DECLARE_BITMAP(vacated, SMMU_PDIR_COUNT);
+};
+
 /*
  * Per address space
  */
@@ -203,6 +218,9 @@ struct smmu_as {
 	u32                     pde_attr;
 	u32                     pte_attr;
 	unsigned int            *pte_count;
+	struct smmu_iotlb_gather gather; /* protected by lock */
+	u32                     nr_section_maps; /* live 4MB mappings */
+	u32                     nr_page_maps;    /* live 4KB mappings */
 
 	struct list_head        client;
 	spinlock_t              client_lock; /* for client list */
@@ -219,6 +237,7 @@ struct smmu_debugfs_info {
 	int mc;
 	int cache;
 	u64 val[2]; /* FIXME: per MC */
+	u64 flush[2]; /* unmap flushes requested/issued */
 	struct timer_list stats_timer;
 };
 
@@ -240,6 +259,9 @@ struct smmu_device {
 	u64             swgids;         /* memory client ID bitmap */
 	u32		ptc_cache_line;
 
+	atomic64_t      flush_requested; /* unmap ranges needing a flush */
+	atomic64_t      flush_issued;    /* flushes actually issued */
+
 	struct rb_root  clients;
 
 	struct dentry *debugfs_root;
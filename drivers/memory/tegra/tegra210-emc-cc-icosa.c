@@ -1221,6 +1221,13 @@ static u32 _minerva_periodic_compensation_handler(struct emc_table *src_emc_entr
 		dst_emc_entry->ptfv_list[PTFV_DQSOSC_MOVAVG_C1D1U0_INDEX] = src_emc_entry->ptfv_list[PTFV_DQSOSC_MOVAVG_C1D1U0_INDEX] * samples;
 		dst_emc_entry->ptfv_list[PTFV_DQSOSC_MOVAVG_C1D1U1_INDEX] = src_emc_entry->ptfv_list[PTFV_DQSOSC_MOVAVG_C1D1U1_INDEX] * samples;
 	}
+	else if (tegra210_emc_train_cache_hit(dst_emc_entry))
+	{
+		// Averages left from the last time this entry was in use are still fresh.
+		u32 samples = dst_emc_entry->ptfv_list[PTFV_DVFS_SAMPLES_INDEX];
+		for (i = PTFV_DQSOSC_MOVAVG_C0D0U0_INDEX; i <= PTFV_DQSOSC_MOVAVG_C1D1U1_INDEX; i++)
+			dst_emc_entry->ptfv_list[i] *= samples;
+	}
 	else
 	{
 		dst_emc_entry->ptfv_list[PTFV_DQSOSC_MOVAVG_C0D0U0_INDEX] = 0;
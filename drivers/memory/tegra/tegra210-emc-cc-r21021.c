@@ -498,6 +498,19 @@ static u32 periodic_compensation_handler(u32 type, u32 dram_dev_num,
 			__COPY_EMA(next_timing, last_timing, C0D1U1);
 			__COPY_EMA(next_timing, last_timing, C1D1U0);
 			__COPY_EMA(next_timing, last_timing, C1D1U1);
+		} else if (tegra210_emc_train_cache_hit(next_timing)) {
+			/*
+			 * The averages left from the last time this
+			 * frequency was in use are still fresh.
+			 */
+			__COPY_EMA(next_timing, next_timing, C0D0U0);
+			__COPY_EMA(next_timing, next_timing, C0D0U1);
+			__COPY_EMA(next_timing, next_timing, C1D0U0);
+			__COPY_EMA(next_timing, next_timing, C1D0U1);
+			__COPY_EMA(next_timing, next_timing, C0D1U0);
+			__COPY_EMA(next_timing, next_timing, C0D1U1);
+			__COPY_EMA(next_timing, next_timing, C1D1U0);
+			__COPY_EMA(next_timing, next_timing, C1D1U1);
 		} else {
 			/* Reset the EMA.*/
 			__MOVAVG(next_timing, C0D0U0) = 0;
@@ -1956,11 +1956,20 @@ struct emc_table {
 	u32 latency;
 };
 
+struct emc_clkchange_latency {
+	u32 last_us;
+	u32 avg_us;
+	u32 max_us;
+	u32 count;
+};
+
 struct emc_stats {
 	cputime64_t time_at_clock[TEGRA_EMC_TABLE_MAX_SIZE];
 	int last_sel;
 	u64 last_update;
 	u64 clkchange_count;
+	struct emc_clkchange_latency
+		latency[TEGRA_EMC_TABLE_MAX_SIZE][TEGRA_EMC_TABLE_MAX_SIZE];
 	spinlock_t spinlock;
 };
 
@@ -2087,6 +2096,7 @@ u32 tegra210_apply_periodic_compensation_trimmer(
 u32 tegra210_dll_prelock(struct emc_table *next_timing,
 			 int dvfs_with_training, u32 clksrc);
 void tegra210_reset_dram_clktree_values(struct emc_table *table);
+bool tegra210_emc_train_cache_hit(struct emc_table *timing);
 u32 tegra210_dvfs_power_ramp_up(u32 clk, int flip_backward,
 				struct emc_table *last_timing,
 				struct emc_table *next_timing);
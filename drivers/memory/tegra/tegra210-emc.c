@@ -20,6 +20,7 @@
 #include <linux/of_address.h>
 #include <linux/of_platform.h>
 #include <linux/thermal.h>
+#include <linux/tegra_soctherm.h>
 
 #include <soc/tegra/bpmp_t210_abi.h>
 #include <soc/tegra/tegra_bpmp.h>
@@ -33,6 +34,10 @@
 #define EMC_STATUS_UPDATE_TIMEOUT		1000
 #define TEGRA210_SAVE_RESTORE_MOD_REGS		12
 #define TEGRA_EMC_DEFAULT_CLK_LATENCY_US	2000
+#define TEGRA_EMC_LATENCY_AVG_SHIFT		3
+
+/* 64-bit DDR interface: 16 bytes are transferred per EMC clock */
+#define TEGRA210_EMC_BYTES_PER_CLK		16
 
 #define EMC0_EMC_CMD_BRLSHFT_0_INDEX	0
 #define EMC1_EMC_CMD_BRLSHFT_1_INDEX	1
@@ -127,6 +132,8 @@ static u32 tegra_ram_code;
 static u32 current_clksrc;
 static u32 timer_period_mr4 = 1000;
 static u32 timer_period_training = 100;
+static u32 train_cache_ms = 100;
+static u32 train_cache_temp_delta = 1000;
 static bool tegra_emc_init_done;
 static void __iomem *emc_base;
 static void __iomem *emc0_base;
@@ -209,18 +216,15 @@ static void emc_train(unsigned long nothing);
 static struct timer_list emc_timer_training =
 	TIMER_INITIALIZER(emc_train, 0, 0);
 
-#ifdef CONFIG_DEBUG_FS
 static u8 tegra210_emc_bw_efficiency = 80;
 static u8 tegra210_emc_iso_share = 100;
 static unsigned long last_iso_bw;
-#endif
 
 static u32 bw_calc_freqs[] = {
 	5, 10, 20, 30, 40, 60, 80, 100, 120, 140, 160, 180,
 	200, 250, 300, 350, 400, 450, 500, 550, 600, 650, 700
 };
 
-#ifdef CONFIG_DEBUG_FS
 static u32 tegra210_lpddr3_iso_efficiency_os_idle[] = {
 	64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
 	64, 63, 60, 54, 45, 45, 45, 45, 45, 45, 45
@@ -273,7 +277,6 @@ static struct emc_iso_usage tegra210_emc_iso_usage[] = {
 		50, iso_share_calc_tegra210_general
 	},
 };
-#endif
 
 inline void emc_writel(u32 val, unsigned long offset)
 {
@@ -494,6 +497,72 @@ static void emc_timer_training_stop(void)
 	del_timer(&emc_timer_training);
 }
 
+/*
+ * While a timing with periodic training is in use, emc_train() keeps its
+ * DQS oscillator averages in ptfv_list up to date. Remember when and at
+ * which SOC_THERM MEM temperature the EMC switched away from it:
+ * switching back before the next periodic training would have run, and
+ * with the MEM temperature within train_cache_temp_delta mC, reuses those
+ * averages instead of sampling the oscillators again. All of this is
+ * protected by emc_access_lock.
+ */
+struct emc_train_cache {
+	ktime_t saved;
+	int mem_temp;
+	bool valid;
+};
+
+static struct emc_train_cache emc_train_cache[TEGRA_EMC_TABLE_MAX_SIZE];
+static struct emc_table *emc_train_cache_timing;
+static u64 emc_train_cache_hits;
+static u64 emc_train_cache_misses;
+
+static void emc_train_cache_invalidate(void)
+{
+	memset(emc_train_cache, 0, sizeof(emc_train_cache));
+	emc_train_cache_timing = NULL;
+}
+
+static void emc_train_cache_save(int idx)
+{
+	struct emc_train_cache *cache = &emc_train_cache[idx];
+
+	cache->valid = tegra_emc_table[idx].periodic_training &&
+		       train_cache_ms &&
+		       !tegra_soctherm_get_mem_temp(&cache->mem_temp);
+	cache->saved = ktime_get();
+}
+
+static void emc_train_cache_lookup(int idx)
+{
+	struct emc_train_cache *cache = &emc_train_cache[idx];
+	u32 max_age = min(train_cache_ms, timer_period_training);
+	int mem_temp;
+
+	emc_train_cache_timing = NULL;
+	if (!tegra_emc_table[idx].periodic_training)
+		return;
+
+	if (cache->valid && !tegra_soctherm_get_mem_temp(&mem_temp) &&
+	    abs(mem_temp - cache->mem_temp) < train_cache_temp_delta &&
+	    ktime_ms_delta(ktime_get(), cache->saved) < max_age) {
+		emc_train_cache_timing = &tegra_emc_table[idx];
+		emc_train_cache_hits++;
+	} else {
+		emc_train_cache_misses++;
+	}
+	cache->valid = false;
+}
+
+/*
+ * Called by the clock change sequences: true if the averages left in
+ * @timing's ptfv_list can be used as they are for this switch.
+ */
+bool tegra210_emc_train_cache_hit(struct emc_table *timing)
+{
+	return timing && timing == emc_train_cache_timing;
+}
+
 void tegra210_change_dll_src(struct emc_table *next_timing, u32 clksrc)
 {
 	u32 out_enb_x;
@@ -1307,7 +1376,12 @@ void tegra210_dll_enable(int channel_mode)
 
 void tegra210_emc_timing_invalidate(void)
 {
+	unsigned long flags;
+
+	spin_lock_irqsave(&emc_access_lock, flags);
 	emc_timing = NULL;
+	emc_train_cache_invalidate();
+	spin_unlock_irqrestore(&emc_access_lock, flags);
 }
 EXPORT_SYMBOL(tegra210_emc_timing_invalidate);
 
@@ -1444,6 +1518,22 @@ unsigned int tegra210_emc_get_clk_latency(unsigned long rate)
 		index = i;
 	}
 
+	/* Prefer what switching from the current rate has actually cost. */
+	if (index >= 0 && emc_timing) {
+		struct emc_clkchange_latency *lat;
+		unsigned long flags;
+		unsigned int avg_us = 0;
+
+		spin_lock_irqsave(&tegra_emc_stats.spinlock, flags);
+		lat = &tegra_emc_stats.latency[last_rate_idx][index];
+		if (lat->count)
+			avg_us = max_t(u32, lat->avg_us, 1);
+		spin_unlock_irqrestore(&tegra_emc_stats.spinlock, flags);
+
+		if (avg_us)
+			return avg_us;
+	}
+
 	if (index > 0 && tegra_emc_table[index].latency)
 		return tegra_emc_table[index].latency;
 
@@ -1521,6 +1611,29 @@ static void emc_last_stats_update(int last_sel)
 	spin_unlock_irqrestore(&tegra_emc_stats.spinlock, flags);
 }
 
+static void emc_latency_stats_update(int from, int to, s64 us)
+{
+	struct emc_clkchange_latency *lat;
+	unsigned long flags;
+	u32 val = clamp_t(s64, us, 0, U32_MAX);
+
+	if (from >= TEGRA_EMC_TABLE_MAX_SIZE || to >= TEGRA_EMC_TABLE_MAX_SIZE)
+		return;
+
+	spin_lock_irqsave(&tegra_emc_stats.spinlock, flags);
+	lat = &tegra_emc_stats.latency[from][to];
+	lat->last_us = val;
+	if (val > lat->max_us)
+		lat->max_us = val;
+	if (!lat->count++)
+		lat->avg_us = val;
+	else
+		lat->avg_us = ((u64)lat->avg_us *
+			       ((1 << TEGRA_EMC_LATENCY_AVG_SHIFT) - 1) +
+			       val) >> TEGRA_EMC_LATENCY_AVG_SHIFT;
+	spin_unlock_irqrestore(&tegra_emc_stats.spinlock, flags);
+}
+
 static int emc_table_lookup(unsigned long rate)
 {
 	int i;
@@ -1569,11 +1682,12 @@ static struct clk *tegra210_emc_predict_parent(unsigned long rate,
 
 static int tegra210_emc_set_rate(unsigned long rate)
 {
-	int i;
+	int i, last_idx = TEGRA_EMC_TABLE_MAX_SIZE;
 	u32 clk_setting;
 	struct emc_table *last_timing;
 	unsigned long flags;
-	s64 last_change_delay;
+	s64 last_change_delay, latency;
+	ktime_t start;
 	struct clk *parent;
 	unsigned long parent_rate;
 
@@ -1603,24 +1717,35 @@ static int tegra210_emc_set_rate(unsigned long rate)
 	} else
 		last_timing = emc_timing;
 
+	start = ktime_get();
 	parent = tegra210_emc_predict_parent(rate, &parent_rate);
 	if (clk_is_match(parent, emc_clk_sel[i].input))
 		clk_setting = emc_clk_sel[i].value;
 	else
 		clk_setting = emc_clk_sel[i].value_b;
+	latency = ktime_us_delta(ktime_get(), start);
 
 	last_change_delay = ktime_us_delta(ktime_get(), clkchange_time);
 	if ((last_change_delay >= 0) && (last_change_delay < clkchange_delay))
 		udelay(clkchange_delay - (int)last_change_delay);
 
 	spin_lock_irqsave(&emc_access_lock, flags);
+	emc_train_cache_lookup(i);
+	start = ktime_get();
 	emc_set_clock(&tegra_emc_table[i], last_timing, 0, clk_setting);
 	clkchange_time = ktime_get();
+	emc_train_cache_timing = NULL;
+	if (emc_timing) {
+		last_idx = last_rate_idx;
+		emc_train_cache_save(last_idx);
+	}
 	emc_timing = &tegra_emc_table[i];
 	last_rate_idx = i;
 	spin_unlock_irqrestore(&emc_access_lock, flags);
 
+	latency += ktime_us_delta(clkchange_time, start);
 	emc_last_stats_update(i);
+	emc_latency_stats_update(last_idx, i, latency);
 
 	return 0;
 }
@@ -1642,7 +1767,6 @@ static inline int bw_calc_get_freq_idx(unsigned long bw)
 	return idx;
 }
 
-#ifdef CONFIG_DEBUG_FS
 static u8 iso_share_calc_tegra210_os_idle(unsigned long iso_bw)
 {
 	int freq_idx = bw_calc_get_freq_idx(iso_bw);
@@ -1682,7 +1806,65 @@ static u8 iso_share_calc_tegra210_general(unsigned long iso_bw)
 
 	return ret;
 }
-#endif
+
+/*
+ * Pick the ISO share for the set of active clients: the most restrictive
+ * entry of the usage table that is fully covered by @usage_flags wins.
+ */
+static u8 tegra210_emc_get_iso_share(u32 usage_flags, unsigned long iso_rate)
+{
+	u8 iso_share = 100;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tegra210_emc_iso_usage); i++) {
+		u32 flags = tegra210_emc_iso_usage[i].emc_usage_flags;
+		u8 share = tegra210_emc_iso_usage[i].iso_usage_share;
+
+		if (!flags || (flags & usage_flags) != flags)
+			continue;
+
+		if (tegra210_emc_iso_usage[i].iso_share_calculator)
+			share = tegra210_emc_iso_usage[i].iso_share_calculator(
+				iso_rate);
+		if (WARN_ON_ONCE(!share))
+			continue;
+
+		iso_share = min(iso_share, share);
+	}
+
+	tegra210_emc_iso_share = iso_share;
+
+	return iso_share;
+}
+
+/*
+ * Translate aggregated bandwidth requests into an EMC rate. @total_bw is
+ * the sum of the average bandwidth of all clients and @iso_bw the peak
+ * bandwidth that must be met without underflow, both in KB/s. Each is
+ * derated by its efficiency and the result is rounded up to a rate in the
+ * DVFS table. Returns the rate in Hz, or 0 if EMC scaling is not available.
+ */
+unsigned long tegra210_emc_bw_to_rate(unsigned long total_bw,
+				      unsigned long iso_bw, u32 usage_flags)
+{
+	unsigned long total_rate, iso_rate;
+	u8 iso_share;
+
+	total_rate = total_bw * 1000 / TEGRA210_EMC_BYTES_PER_CLK;
+	iso_rate = iso_bw * 1000 / TEGRA210_EMC_BYTES_PER_CLK;
+
+	if (total_rate && tegra210_emc_bw_efficiency)
+		total_rate = total_rate / tegra210_emc_bw_efficiency * 100;
+
+	last_iso_bw = iso_bw;
+	if (iso_rate) {
+		iso_share = tegra210_emc_get_iso_share(usage_flags, iso_rate);
+		iso_rate = iso_rate / iso_share * 100;
+	}
+
+	return tegra210_emc_round_rate(max(total_rate, iso_rate));
+}
+EXPORT_SYMBOL(tegra210_emc_bw_to_rate);
 
 static const struct emc_clk_ops tegra210_emc_clk_ops = {
 	.emc_get_rate = tegra210_emc_get_rate,
@@ -1846,6 +2028,7 @@ int tegra210_emc_set_over_temp_state(unsigned long state)
 	dram_over_temp_state = state;
 
 	if (current_table != new_table) {
+		emc_train_cache_invalidate();
 		emc_set_clock(&new_table[last_rate_idx], emc_timing, 0,
 			      current_clksrc | EMC_CLK_FORCE_CC_TRIGGER);
 		emc_timing = &new_table[last_rate_idx];
@@ -1865,7 +2048,9 @@ int tegra210_emc_set_over_temp_state(unsigned long state)
 #ifdef CONFIG_DEBUG_FS
 static int emc_stats_show(struct seq_file *s, void *data)
 {
-	int i;
+	struct emc_clkchange_latency lat;
+	unsigned long flags;
+	int i, j;
 
 	emc_last_stats_update(TEGRA_EMC_TABLE_MAX_SIZE);
 
@@ -1884,6 +2069,27 @@ static int emc_stats_show(struct seq_file *s, void *data)
 	seq_printf(s, "%-15s %llu\n", "time-stamp:",
 		   cputime64_to_clock_t(tegra_emc_stats.last_update));
 
+	seq_printf(s, "\n%-10s %-10s %-10s %-10s %-10s %-10s\n", "from kHz",
+		   "to kHz", "count", "last us", "avg us", "max us");
+	for (i = 0; i < tegra_emc_table_size; i++) {
+		for (j = 0; j < tegra_emc_table_size; j++) {
+			spin_lock_irqsave(&tegra_emc_stats.spinlock, flags);
+			lat = tegra_emc_stats.latency[i][j];
+			spin_unlock_irqrestore(&tegra_emc_stats.spinlock,
+					       flags);
+			if (!lat.count)
+				continue;
+
+			seq_printf(s, "%-10u %-10u %-10u %-10u %-10u %-10u\n",
+				   tegra_emc_table[i].rate,
+				   tegra_emc_table[j].rate, lat.count,
+				   lat.last_us, lat.avg_us, lat.max_us);
+		}
+	}
+	seq_printf(s, "%-15s %llu\n", "train hits:", emc_train_cache_hits);
+	seq_printf(s, "%-15s %llu\n", "train misses:",
+		   emc_train_cache_misses);
+
 	return 0;
 }
 
@@ -2153,6 +2359,14 @@ static int tegra_emc_debug_init(void)
 					S_IRUGO | S_IWUSR, emc_debugfs_root,
 					&timer_period_training))
 			goto err_out;
+		if (!debugfs_create_u32("training_cache_ms",
+					S_IRUGO | S_IWUSR, emc_debugfs_root,
+					&train_cache_ms))
+			goto err_out;
+		if (!debugfs_create_u32("training_cache_temp_delta",
+					S_IRUGO | S_IWUSR, emc_debugfs_root,
+					&train_cache_temp_delta))
+			goto err_out;
 	}
 
 	if (!debugfs_create_file("tables_info", S_IRUGO, emc_debugfs_root,
@@ -2748,6 +2962,13 @@ static int tegra210_emc_suspend(struct device *dev)
 
 static int tegra210_emc_resume(struct device *dev)
 {
+	unsigned long flags;
+
+	/* DRAM temperature is not tracked across suspend. */
+	spin_lock_irqsave(&emc_access_lock, flags);
+	emc_train_cache_invalidate();
+	spin_unlock_irqrestore(&emc_access_lock, flags);
+
 	if (!IS_ERR(emc_override_clk)) {
 		clk_set_rate(emc_override_clk, emc_override_rate);
 		clk_disable_unprepare(emc_override_clk);
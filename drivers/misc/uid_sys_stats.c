@@ -15,18 +15,21 @@
 
 #include <linux/atomic.h>
 #include <linux/cpufreq_times.h>
+#include <linux/cred.h>
 #include <linux/err.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/mm.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/profile.h>
 #include <linux/rtmutex.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
 
 
@@ -34,6 +37,8 @@
 DECLARE_HASHTABLE(hash_table, UID_HASH_BITS);
 
 static DEFINE_RT_MUTEX(uid_lock);
+/* Protects hash_table against concurrent registrations from uid_io_account() */
+static DEFINE_SPINLOCK(uid_hash_lock);
 static struct proc_dir_entry *cpu_parent;
 static struct proc_dir_entry *io_parent;
 static struct proc_dir_entry *proc_parent;
@@ -72,20 +77,15 @@ struct uid_entry {
 	cputime_t active_stime;
 	int state;
 	struct io_stats io[UID_STATE_SIZE];
+	/* I/O done while running as this uid, charged as it happens */
+	atomic64_t io_total[UID_IO_NR_STATS];
 	struct hlist_node hash;
+	struct rcu_head rcu;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
 	DECLARE_HASHTABLE(task_entries, UID_HASH_BITS);
 #endif
 };
 
-static u64 compute_write_bytes(struct task_struct *task)
-{
-	if (task->ioac.write_bytes <= task->ioac.cancelled_write_bytes)
-		return 0;
-
-	return task->ioac.write_bytes - task->ioac.cancelled_write_bytes;
-}
-
 static void compute_io_bucket_stats(struct io_stats *io_bucket,
 					struct io_stats *io_curr,
 					struct io_stats *io_last,
@@ -120,6 +120,14 @@ static void compute_io_bucket_stats(struct io_stats *io_bucket,
 }
 
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
+static u64 compute_write_bytes(struct task_struct *task)
+{
+	if (task->ioac.write_bytes <= task->ioac.cancelled_write_bytes)
+		return 0;
+
+	return task->ioac.write_bytes - task->ioac.cancelled_write_bytes;
+}
+
 static void get_full_task_comm(struct task_entry *task_entry,
 		struct task_struct *task)
 {
@@ -253,6 +261,33 @@ static void add_uid_tasks_io_stats(struct uid_entry *uid_entry,
 	task_io_slot->fsync += task->ioac.syscfs;
 }
 
+/*
+ * Only the optional per-task view still needs to walk every thread: the
+ * per-uid totals are charged as the I/O happens.
+ */
+static struct uid_entry *find_or_register_uid(uid_t uid);
+
+static void update_io_uid_tasks(struct uid_entry *only)
+{
+	struct uid_entry *uid_entry = NULL;
+	struct task_struct *task, *temp;
+	struct user_namespace *user_ns = current_user_ns();
+	uid_t uid;
+
+	rcu_read_lock();
+	do_each_thread(temp, task) {
+		uid = from_kuid_munged(user_ns, task_uid(task));
+		if (only && uid != only->uid)
+			continue;
+		if (!uid_entry || uid_entry->uid != uid)
+			uid_entry = find_or_register_uid(uid);
+		if (!uid_entry)
+			continue;
+		add_uid_tasks_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
+	} while_each_thread(temp, task);
+	rcu_read_unlock();
+}
+
 static void compute_io_uid_tasks(struct uid_entry *uid_entry)
 {
 	struct task_entry *task_entry;
@@ -293,15 +328,17 @@ static void remove_uid_tasks(struct uid_entry *uid_entry) {};
 static void set_io_uid_tasks_zero(struct uid_entry *uid_entry) {};
 static void add_uid_tasks_io_stats(struct uid_entry *uid_entry,
 		struct task_struct *task, int slot) {};
+static void update_io_uid_tasks(struct uid_entry *only) {};
 static void compute_io_uid_tasks(struct uid_entry *uid_entry) {};
 static void show_io_uid_tasks(struct seq_file *m,
 		struct uid_entry *uid_entry) {}
 #endif
 
+/* Caller must hold uid_lock, uid_hash_lock or rcu_read_lock() */
 static struct uid_entry *find_uid_entry(uid_t uid)
 {
 	struct uid_entry *uid_entry;
-	hash_for_each_possible(hash_table, uid_entry, hash, uid) {
+	hash_for_each_possible_rcu(hash_table, uid_entry, hash, uid) {
 		if (uid_entry->uid == uid)
 			return uid_entry;
 	}
@@ -310,25 +347,150 @@ static struct uid_entry *find_uid_entry(uid_t uid)
 
 static struct uid_entry *find_or_register_uid(uid_t uid)
 {
-	struct uid_entry *uid_entry;
+	struct uid_entry *uid_entry, *new_entry;
+	unsigned long flags;
 
 	uid_entry = find_uid_entry(uid);
 	if (uid_entry)
 		return uid_entry;
 
-	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_ATOMIC);
-	if (!uid_entry)
+	new_entry = kzalloc(sizeof(struct uid_entry), GFP_ATOMIC);
+	if (!new_entry)
 		return NULL;
 
-	uid_entry->uid = uid;
+	new_entry->uid = uid;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
-	hash_init(uid_entry->task_entries);
+	hash_init(new_entry->task_entries);
 #endif
-	hash_add(hash_table, &uid_entry->hash, uid);
+
+	spin_lock_irqsave(&uid_hash_lock, flags);
+	uid_entry = find_uid_entry(uid);
+	if (!uid_entry) {
+		hash_add_rcu(hash_table, &new_entry->hash, uid);
+		uid_entry = new_entry;
+		new_entry = NULL;
+	}
+	spin_unlock_irqrestore(&uid_hash_lock, flags);
+
+	kfree(new_entry);
 
 	return uid_entry;
 }
 
+/*
+ * I/O charged on a CPU and not yet folded into the uid entries. Each CPU
+ * caches a few uids, so the accounting points only bump a local counter
+ * while the same uids keep doing I/O there.
+ */
+#define UID_IO_SLOT_BITS	2
+
+struct uid_io_slot {
+	uid_t uid;
+	u64 pending[UID_IO_NR_STATS];
+};
+
+struct uid_io_pcpu {
+	spinlock_t lock;
+	struct uid_io_slot slots[1 << UID_IO_SLOT_BITS];
+};
+
+static DEFINE_PER_CPU(struct uid_io_pcpu, uid_io_pcpu) = {
+	.lock = __SPIN_LOCK_UNLOCKED(uid_io_pcpu.lock),
+};
+
+/* Caller must hold the slot's uid_io_pcpu lock */
+static void fold_uid_io_slot(struct uid_io_slot *slot)
+{
+	struct uid_entry *uid_entry;
+	int i;
+
+	for (i = 0; i < UID_IO_NR_STATS; i++) {
+		if (slot->pending[i])
+			break;
+	}
+	if (i == UID_IO_NR_STATS)
+		return;
+
+	rcu_read_lock();
+	uid_entry = find_or_register_uid(slot->uid);
+	if (uid_entry) {
+		for (i = 0; i < UID_IO_NR_STATS; i++)
+			atomic64_add(slot->pending[i],
+				     &uid_entry->io_total[i]);
+	}
+	rcu_read_unlock();
+
+	memset(slot->pending, 0, sizeof(slot->pending));
+}
+
+/* Fold the I/O pending on every CPU into the uid entries */
+static void fold_uid_io_all(void)
+{
+	struct uid_io_pcpu *pcpu;
+	unsigned long flags;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		pcpu = &per_cpu(uid_io_pcpu, cpu);
+
+		spin_lock_irqsave(&pcpu->lock, flags);
+		for (i = 0; i < ARRAY_SIZE(pcpu->slots); i++)
+			fold_uid_io_slot(&pcpu->slots[i]);
+		spin_unlock_irqrestore(&pcpu->lock, flags);
+	}
+}
+
+/**
+ * uid_io_account - charge I/O to the uid of the current task
+ * @stat: the I/O statistic to charge
+ * @amt: the amount to add
+ *
+ * Called from the task I/O accounting points, so that reading the per-uid
+ * totals does not need to walk every thread in the system. The amount is
+ * kept on this CPU until the stats are read or the slot is taken over by
+ * another uid.
+ */
+void uid_io_account(enum uid_io_stat stat, u64 amt)
+{
+	uid_t uid = __kuid_val(current_uid());
+	struct uid_io_pcpu *pcpu;
+	struct uid_io_slot *slot;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pcpu = this_cpu_ptr(&uid_io_pcpu);
+	spin_lock(&pcpu->lock);
+
+	slot = &pcpu->slots[hash_32(uid, UID_IO_SLOT_BITS)];
+	if (slot->uid != uid) {
+		fold_uid_io_slot(slot);
+		slot->uid = uid;
+	}
+	slot->pending[stat] += amt;
+
+	spin_unlock(&pcpu->lock);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(uid_io_account);
+
+static void read_uid_io_totals(struct uid_entry *uid_entry,
+			       struct io_stats *io)
+{
+	atomic64_t *total = uid_entry->io_total;
+	u64 write_bytes, cancelled_write_bytes;
+
+	io->rchar = atomic64_read(&total[UID_IO_RCHAR]);
+	io->wchar = atomic64_read(&total[UID_IO_WCHAR]);
+	io->read_bytes = atomic64_read(&total[UID_IO_READ_BYTES]);
+	io->fsync = atomic64_read(&total[UID_IO_FSYNC]);
+
+	write_bytes = atomic64_read(&total[UID_IO_WRITE_BYTES]);
+	cancelled_write_bytes =
+		atomic64_read(&total[UID_IO_CANCELLED_WRITE_BYTES]);
+	io->write_bytes = write_bytes > cancelled_write_bytes ?
+			  write_bytes - cancelled_write_bytes : 0;
+}
+
 static int uid_cputime_show(struct seq_file *m, void *v)
 {
 	struct uid_entry *uid_entry = NULL;
@@ -341,7 +503,7 @@ static int uid_cputime_show(struct seq_file *m, void *v)
 
 	rt_mutex_lock(&uid_lock);
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
 		uid_entry->active_stime = 0;
 		uid_entry->active_utime = 0;
 	}
@@ -364,7 +526,7 @@ static int uid_cputime_show(struct seq_file *m, void *v)
 	} while_each_thread(temp, task);
 	rcu_read_unlock();
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
 		cputime_t total_utime = uid_entry->utime +
 							uid_entry->active_utime;
 		cputime_t total_stime = uid_entry->stime +
@@ -405,6 +567,7 @@ static ssize_t uid_remove_write(struct file *file,
 	char uids[128];
 	char *start_uid, *end_uid = NULL;
 	long int uid_start = 0, uid_end = 0;
+	unsigned long flags;
 
 	if (count >= sizeof(uids))
 		count = sizeof(uids) - 1;
@@ -430,14 +593,16 @@ static ssize_t uid_remove_write(struct file *file,
 	rt_mutex_lock(&uid_lock);
 
 	for (; uid_start <= uid_end; uid_start++) {
+		spin_lock_irqsave(&uid_hash_lock, flags);
 		hash_for_each_possible_safe(hash_table, uid_entry, tmp,
 							hash, (uid_t)uid_start) {
 			if (uid_start == uid_entry->uid) {
 				remove_uid_tasks(uid_entry);
-				hash_del(&uid_entry->hash);
-				kfree(uid_entry);
+				hash_del_rcu(&uid_entry->hash);
+				kfree_rcu(uid_entry, rcu);
 			}
 		}
+		spin_unlock_irqrestore(&uid_hash_lock, flags);
 	}
 
 	rt_mutex_unlock(&uid_lock);
@@ -451,46 +616,21 @@ static const struct file_operations uid_remove_fops = {
 };
 
 
-static void add_uid_io_stats(struct uid_entry *uid_entry,
-			struct task_struct *task, int slot)
-{
-	struct io_stats *io_slot = &uid_entry->io[slot];
-
-	io_slot->read_bytes += task->ioac.read_bytes;
-	io_slot->write_bytes += compute_write_bytes(task);
-	io_slot->rchar += task->ioac.rchar;
-	io_slot->wchar += task->ioac.wchar;
-	io_slot->fsync += task->ioac.syscfs;
-
-	add_uid_tasks_io_stats(uid_entry, task, slot);
-}
-
 static void update_io_stats_all_locked(void)
 {
-	struct uid_entry *uid_entry = NULL;
-	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
+	struct uid_entry *uid_entry;
 	unsigned long bkt;
-	uid_t uid;
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
-			sizeof(struct io_stats));
+	fold_uid_io_all();
+
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
+		read_uid_io_totals(uid_entry, &uid_entry->io[UID_STATE_TOTAL_CURR]);
 		set_io_uid_tasks_zero(uid_entry);
 	}
 
-	rcu_read_lock();
-	do_each_thread(temp, task) {
-		uid = from_kuid_munged(user_ns, task_uid(task));
-		if (!uid_entry || uid_entry->uid != uid)
-			uid_entry = find_or_register_uid(uid);
-		if (!uid_entry)
-			continue;
-		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
-	} while_each_thread(temp, task);
-	rcu_read_unlock();
+	update_io_uid_tasks(NULL);
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
 		compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
 					&uid_entry->io[UID_STATE_TOTAL_CURR],
 					&uid_entry->io[UID_STATE_TOTAL_LAST],
@@ -501,20 +641,11 @@ static void update_io_stats_all_locked(void)
 
 static void update_io_stats_uid_locked(struct uid_entry *uid_entry)
 {
-	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
-
-	memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
-		sizeof(struct io_stats));
+	fold_uid_io_all();
+	read_uid_io_totals(uid_entry, &uid_entry->io[UID_STATE_TOTAL_CURR]);
 	set_io_uid_tasks_zero(uid_entry);
 
-	rcu_read_lock();
-	do_each_thread(temp, task) {
-		if (from_kuid_munged(user_ns, task_uid(task)) != uid_entry->uid)
-			continue;
-		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
-	} while_each_thread(temp, task);
-	rcu_read_unlock();
+	update_io_uid_tasks(uid_entry);
 
 	compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
 				&uid_entry->io[UID_STATE_TOTAL_CURR],
@@ -533,7 +664,7 @@ static int uid_io_show(struct seq_file *m, void *v)
 
 	update_io_stats_all_locked();
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
 		seq_printf(m, "%d %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
 				uid_entry->uid,
 				uid_entry->io[UID_STATE_FOREGROUND].rchar,
@@ -645,7 +776,8 @@ static int process_notifier(struct notifier_block *self,
 	uid_entry->utime += utime;
 	uid_entry->stime += stime;
 
-	add_uid_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
+	/* The uid's I/O totals already include what the task did */
+	add_uid_tasks_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
 
 exit:
 	rt_mutex_unlock(&uid_lock);
@@ -30,6 +30,7 @@
 #include <linux/slab.h>
 #include <linux/cpu.h>
 #include <linux/cpu_cooling.h>
+#include <linux/spinlock.h>
 
 #include <trace/events/thermal.h>
 
@@ -60,6 +61,46 @@ struct power_table {
 	u32 power;
 };
 
+/*
+ * Online power model. When the platform reports measured cpu power,
+ * the estimate is refined as
+ *
+ *	P = c0 * Pdyn + n * V * (c1 + c2 * T)
+ *
+ * where Pdyn is the dynamic power from the capacitance table scaled by
+ * load, n the number of online cpus, V the OPP voltage and T the zone
+ * temperature. The second term approximates the exponential growth of
+ * leakage with temperature by a line, which holds well enough over the
+ * range in which the power allocator operates.
+ */
+enum {
+	POWER_MODEL_DYN,
+	POWER_MODEL_LEAK,
+	POWER_MODEL_LEAK_TEMP,
+	POWER_MODEL_NR_COEFFS,
+};
+
+#define POWER_MODEL_SHIFT		10
+#define POWER_MODEL_ONE			(1 << POWER_MODEL_SHIFT)
+/* Each sample moves the fit by 1/2^3 of its prediction error */
+#define POWER_MODEL_STEP_SHIFT		3
+#define POWER_MODEL_MIN_SAMPLES		16
+
+/**
+ * struct cpu_power_model - cpu power model fitted from power telemetry
+ * @lock:	protects the fields below
+ * @coeff:	coefficients of the model, in units of 1/POWER_MODEL_ONE
+ * @x:		inputs of the model sampled by the last call to
+ *		cpufreq_get_requested_power(), 0 once consumed
+ * @nr_samples:	number of measurements the model has been fitted to
+ */
+struct cpu_power_model {
+	spinlock_t lock;
+	s64 coeff[POWER_MODEL_NR_COEFFS];
+	s64 x[POWER_MODEL_NR_COEFFS];
+	unsigned int nr_samples;
+};
+
 /**
  * struct cpufreq_cooling_device - data for cooling device with cpufreq
  * @id: unique integer value corresponding to each cpufreq_cooling_device
@@ -83,6 +124,7 @@ struct power_table {
  * @dyn_power_table_entries: number of entries in the @dyn_power_table array
  * @cpu_dev: the first cpu_device from @allowed_cpus that has OPPs registered
  * @plat_get_static_power: callback to calculate the static power
+ * @model: power model refined by cpufreq_cooling_update_power()
  *
  * This structure is required for keeping information of each registered
  * cpufreq_cooling_device.
@@ -103,6 +145,7 @@ struct cpufreq_cooling_device {
 	int dyn_power_table_entries;
 	struct device *cpu_dev;
 	get_static_t plat_get_static_power;
+	struct cpu_power_model model;
 };
 static DEFINE_IDR(cpufreq_idr);
 static DEFINE_MUTEX(cooling_cpufreq_lock);
@@ -405,6 +448,90 @@ static u32 get_load(struct cpufreq_cooling_device *cpufreq_device, int cpu,
 	return load;
 }
 
+/**
+ * get_voltage() - look up the OPP voltage of the cpus
+ * @cpufreq_device:	struct &cpufreq_cooling_device for this cpu cdev
+ * @freq:	frequency in KHz
+ *
+ * Return: the voltage in uV, or 0 if there is no OPP for @freq.
+ */
+static unsigned long get_voltage(struct cpufreq_cooling_device *cpufreq_device,
+				 unsigned long freq)
+{
+	struct dev_pm_opp *opp;
+	unsigned long voltage;
+	unsigned long freq_hz = freq * 1000;
+
+	rcu_read_lock();
+
+	opp = dev_pm_opp_find_freq_exact(cpufreq_device->cpu_dev, freq_hz,
+					 true);
+	voltage = dev_pm_opp_get_voltage(opp);
+
+	rcu_read_unlock();
+
+	if (voltage == 0)
+		dev_warn_ratelimited(cpufreq_device->cpu_dev,
+				     "Failed to get voltage for frequency %lu: %ld\n",
+				     freq_hz, IS_ERR(opp) ? PTR_ERR(opp) : 0);
+
+	return voltage;
+}
+
+static bool power_model_valid(struct cpufreq_cooling_device *cpufreq_device)
+{
+	return READ_ONCE(cpufreq_device->model.nr_samples) >=
+		POWER_MODEL_MIN_SAMPLES;
+}
+
+/* Inputs of the leakage terms: cpus * 10mV, and the same times degC / 100 */
+static void power_model_leak_inputs(unsigned int num_cpus,
+				    unsigned long voltage, int temp, s64 *x)
+{
+	x[POWER_MODEL_LEAK] = div_u64((u64)num_cpus * voltage, 10000);
+	x[POWER_MODEL_LEAK_TEMP] = div_s64(x[POWER_MODEL_LEAK] *
+					   max(temp, 0), 100000);
+}
+
+static u32 power_model_leakage(struct cpufreq_cooling_device *cpufreq_device,
+			       unsigned long voltage, int temp)
+{
+	struct cpu_power_model *model = &cpufreq_device->model;
+	unsigned int num_cpus;
+	unsigned long flags;
+	cpumask_t cpumask;
+	s64 x[POWER_MODEL_NR_COEFFS];
+	s64 power;
+
+	cpumask_and(&cpumask, &cpufreq_device->allowed_cpus, cpu_online_mask);
+	num_cpus = cpumask_weight(&cpumask);
+	power_model_leak_inputs(num_cpus, voltage, temp, x);
+
+	spin_lock_irqsave(&model->lock, flags);
+	power = model->coeff[POWER_MODEL_LEAK] * x[POWER_MODEL_LEAK] +
+		model->coeff[POWER_MODEL_LEAK_TEMP] * x[POWER_MODEL_LEAK_TEMP];
+	spin_unlock_irqrestore(&model->lock, flags);
+
+	return power > 0 ? power >> POWER_MODEL_SHIFT : 0;
+}
+
+/* Scale of the dynamic power table learnt by the model, 1.0 until valid */
+static s64 power_model_dyn_scale(struct cpufreq_cooling_device *cpufreq_device)
+{
+	struct cpu_power_model *model = &cpufreq_device->model;
+	unsigned long flags;
+	s64 scale;
+
+	if (!power_model_valid(cpufreq_device))
+		return POWER_MODEL_ONE;
+
+	spin_lock_irqsave(&model->lock, flags);
+	scale = model->coeff[POWER_MODEL_DYN];
+	spin_unlock_irqrestore(&model->lock, flags);
+
+	return scale;
+}
+
 /**
  * get_static_power() - calculate the static power consumed by the cpus
  * @cpufreq_device:	struct &cpufreq_cooling_device for this cpu cdev
@@ -413,10 +540,12 @@ static u32 get_load(struct cpufreq_cooling_device *cpufreq_device, int cpu,
  * @power:	pointer in which to store the calculated static power
  *
  * Calculate the static power consumed by the cpus described by
- * @cpu_actor running at frequency @freq.  This function relies on a
- * platform specific function that should have been provided when the
- * actor was registered.  If it wasn't, the static power is assumed to
- * be negligible.  The calculated static power is stored in @power.
+ * @cpu_actor running at frequency @freq.  Once the power model has been
+ * fitted to enough measurements, its temperature-dependent leakage is
+ * used.  Otherwise this relies on a platform specific function that
+ * should have been provided when the actor was registered.  If it
+ * wasn't, the static power is assumed to be negligible.  The
+ * calculated static power is stored in @power.
  *
  * Return: 0 on success, -E* on failure.
  */
@@ -424,30 +553,24 @@ static int get_static_power(struct cpufreq_cooling_device *cpufreq_device,
 			    struct thermal_zone_device *tz, unsigned long freq,
 			    u32 *power)
 {
-	struct dev_pm_opp *opp;
 	unsigned long voltage;
 	struct cpumask *cpumask = &cpufreq_device->allowed_cpus;
-	unsigned long freq_hz = freq * 1000;
+	bool model_valid = power_model_valid(cpufreq_device);
 
-	if (!cpufreq_device->plat_get_static_power ||
+	if ((!cpufreq_device->plat_get_static_power && !model_valid) ||
 	    !cpufreq_device->cpu_dev) {
 		*power = 0;
 		return 0;
 	}
 
-	rcu_read_lock();
-
-	opp = dev_pm_opp_find_freq_exact(cpufreq_device->cpu_dev, freq_hz,
-					 true);
-	voltage = dev_pm_opp_get_voltage(opp);
-
-	rcu_read_unlock();
-
-	if (voltage == 0) {
-		dev_warn_ratelimited(cpufreq_device->cpu_dev,
-				     "Failed to get voltage for frequency %lu: %ld\n",
-				     freq_hz, IS_ERR(opp) ? PTR_ERR(opp) : 0);
+	voltage = get_voltage(cpufreq_device, freq);
+	if (voltage == 0)
 		return -EINVAL;
+
+	if (model_valid) {
+		*power = power_model_leakage(cpufreq_device, voltage,
+					     tz->temperature);
+		return 0;
 	}
 
 	return cpufreq_device->plat_get_static_power(cpumask, tz->passive_delay,
@@ -458,17 +581,59 @@ static int get_static_power(struct cpufreq_cooling_device *cpufreq_device,
  * get_dynamic_power() - calculate the dynamic power
  * @cpufreq_device:	&cpufreq_cooling_device for this cdev
  * @freq:	current frequency
+ * @raw_power:	pointer in which to store the dynamic power before it is
+ *		scaled by the power model
  *
  * Return: the dynamic power consumed by the cpus described by
  * @cpufreq_device.
  */
 static u32 get_dynamic_power(struct cpufreq_cooling_device *cpufreq_device,
-			     unsigned long freq)
+			     unsigned long freq, u32 *raw_power)
 {
 	u32 raw_cpu_power;
 
 	raw_cpu_power = cpu_freq_to_power(cpufreq_device, freq);
-	return (raw_cpu_power * cpufreq_device->last_load) / 100;
+	*raw_power = (raw_cpu_power * cpufreq_device->last_load) / 100;
+
+	return (*raw_power * power_model_dyn_scale(cpufreq_device)) >>
+		POWER_MODEL_SHIFT;
+}
+
+/**
+ * power_model_sample() - record the inputs of the power model
+ * @cpufreq_device:	&cpufreq_cooling_device for this cdev
+ * @tz:		thermal zone device in which we're operating
+ * @freq:	current frequency
+ * @raw_power:	dynamic power before scaling by the model
+ *
+ * The inputs are paired with the next measurement passed to
+ * cpufreq_cooling_update_power().
+ */
+static void power_model_sample(struct cpufreq_cooling_device *cpufreq_device,
+			       struct thermal_zone_device *tz,
+			       unsigned long freq, u32 raw_power)
+{
+	struct cpu_power_model *model = &cpufreq_device->model;
+	s64 x[POWER_MODEL_NR_COEFFS];
+	unsigned int num_cpus;
+	unsigned long voltage, flags;
+	cpumask_t cpumask;
+
+	if (!cpufreq_device->cpu_dev)
+		return;
+
+	voltage = get_voltage(cpufreq_device, freq);
+	if (!voltage)
+		return;
+
+	cpumask_and(&cpumask, &cpufreq_device->allowed_cpus, cpu_online_mask);
+	num_cpus = cpumask_weight(&cpumask);
+	power_model_leak_inputs(num_cpus, voltage, tz->temperature, x);
+	x[POWER_MODEL_DYN] = raw_power;
+
+	spin_lock_irqsave(&model->lock, flags);
+	memcpy(model->x, x, sizeof(model->x));
+	spin_unlock_irqrestore(&model->lock, flags);
 }
 
 /* cpufreq cooling device callback functions are defined below */
@@ -575,7 +740,7 @@ static int cpufreq_get_requested_power(struct thermal_cooling_device *cdev,
 {
 	unsigned long freq;
 	int i = 0, cpu, ret;
-	u32 static_power, dynamic_power, total_load = 0;
+	u32 static_power, dynamic_power, raw_power, total_load = 0;
 	struct cpufreq_cooling_device *cpufreq_device = cdev->devdata;
 	u32 *load_cpu = NULL;
 
@@ -615,13 +780,15 @@ static int cpufreq_get_requested_power(struct thermal_cooling_device *cdev,
 
 	cpufreq_device->last_load = total_load;
 
-	dynamic_power = get_dynamic_power(cpufreq_device, freq);
+	dynamic_power = get_dynamic_power(cpufreq_device, freq, &raw_power);
 	ret = get_static_power(cpufreq_device, tz, freq, &static_power);
 	if (ret) {
 		kfree(load_cpu);
 		return ret;
 	}
 
+	power_model_sample(cpufreq_device, tz, freq, raw_power);
+
 	if (load_cpu) {
 		trace_thermal_power_cpu_get_power(
 			&cpufreq_device->allowed_cpus,
@@ -673,6 +840,8 @@ static int cpufreq_state2power(struct thermal_cooling_device *cdev,
 		return -EINVAL;
 
 	dynamic_power = cpu_freq_to_power(cpufreq_device, freq) * num_cpus;
+	dynamic_power = (dynamic_power * power_model_dyn_scale(cpufreq_device)) >>
+		POWER_MODEL_SHIFT;
 	ret = get_static_power(cpufreq_device, tz, freq, &static_power);
 	if (ret)
 		return ret;
@@ -726,6 +895,8 @@ static int cpufreq_power2state(struct thermal_cooling_device *cdev,
 	dyn_power = dyn_power > 0 ? dyn_power : 0;
 	last_load = cpufreq_device->last_load ?: 1;
 	normalised_power = (dyn_power * 100) / last_load;
+	normalised_power = div64_s64((s64)normalised_power << POWER_MODEL_SHIFT,
+				     power_model_dyn_scale(cpufreq_device));
 	target_freq = cpu_power_to_freq(cpufreq_device, normalised_power);
 
 	*state = cpufreq_cooling_get_level(cpu, target_freq);
@@ -758,6 +929,75 @@ static struct thermal_cooling_device_ops cpufreq_power_cooling_ops = {
 	.power2state		= cpufreq_power2state,
 };
 
+/**
+ * cpufreq_cooling_update_power() - fit the cpu power model to a measurement
+ * @cdev:	&thermal_cooling_device registered with power extensions
+ * @power:	power drawn by the cpus of @cdev, in mW
+ *
+ * The power allocator calls this with the cpus' share of the zone's
+ * sustainable power while the zone is settled at its control
+ * temperature.  Platforms with telemetry on the cpu rail may also call
+ * it with the average power since the previous call, ideally once per
+ * polling interval of the thermal zone.  The measurement is paired with
+ * the load, voltage and temperature seen by the last
+ * cpufreq_get_requested_power() and used for one normalised least mean
+ * squares step of the power model.
+ * After %POWER_MODEL_MIN_SAMPLES measurements, the model replaces the
+ * capacitance-only estimate and the platform static power callback.
+ */
+void cpufreq_cooling_update_power(struct thermal_cooling_device *cdev,
+				  u32 power)
+{
+	struct cpufreq_cooling_device *cpufreq_device;
+	struct cpu_power_model *model;
+	s64 predicted = 0, norm = 1, err;
+	unsigned long flags;
+	int i;
+
+	if (!cdev || cdev->ops != &cpufreq_power_cooling_ops)
+		return;
+
+	cpufreq_device = cdev->devdata;
+	model = &cpufreq_device->model;
+
+	spin_lock_irqsave(&model->lock, flags);
+
+	/* No inputs sampled since the last measurement */
+	if (!model->x[POWER_MODEL_DYN] && !model->x[POWER_MODEL_LEAK])
+		goto unlock;
+
+	for (i = 0; i < POWER_MODEL_NR_COEFFS; i++) {
+		predicted += model->coeff[i] * model->x[i];
+		norm += model->x[i] * model->x[i];
+	}
+
+	err = (s64)power - (predicted >> POWER_MODEL_SHIFT);
+
+	for (i = 0; i < POWER_MODEL_NR_COEFFS; i++)
+		model->coeff[i] += div64_s64(err * model->x[i] *
+					     (POWER_MODEL_ONE >>
+					      POWER_MODEL_STEP_SHIFT), norm);
+
+	/*
+	 * Keep the fit physical: the table may be off by a few times but not
+	 * by orders of magnitude, and leakage does not drop as it heats up.
+	 */
+	model->coeff[POWER_MODEL_DYN] = clamp_t(s64,
+						model->coeff[POWER_MODEL_DYN],
+						POWER_MODEL_ONE / 4,
+						POWER_MODEL_ONE * 4);
+	if (model->coeff[POWER_MODEL_LEAK_TEMP] < 0)
+		model->coeff[POWER_MODEL_LEAK_TEMP] = 0;
+
+	memset(model->x, 0, sizeof(model->x));
+	if (model->nr_samples < POWER_MODEL_MIN_SAMPLES)
+		model->nr_samples++;
+
+unlock:
+	spin_unlock_irqrestore(&model->lock, flags);
+}
+EXPORT_SYMBOL_GPL(cpufreq_cooling_update_power);
+
 /* Notifier for cpufreq policy change */
 static struct notifier_block thermal_cpufreq_notifier_block = {
 	.notifier_call = cpufreq_thermal_notifier,
@@ -864,6 +1104,8 @@ __cpufreq_cooling_register(struct device_node *np,
 
 	if (capacitance) {
 		cpufreq_dev->plat_get_static_power = plat_static_func;
+		spin_lock_init(&cpufreq_dev->model.lock);
+		cpufreq_dev->model.coeff[POWER_MODEL_DYN] = POWER_MODEL_ONE;
 
 		ret = build_dyn_power_table(cpufreq_dev, capacitance);
 		if (ret) {
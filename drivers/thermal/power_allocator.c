@@ -15,6 +15,7 @@
 
 #define pr_fmt(fmt) "Power allocator: " fmt
 
+#include <linux/cpu_cooling.h>
 #include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/thermal.h>
@@ -26,6 +27,14 @@
 
 #define INVALID_TRIP -1
 
+/*
+ * The zone counts as settled at the control temperature when it is
+ * within POWER_MODEL_TEMP_WINDOW of it and moved less than
+ * POWER_MODEL_TEMP_DELTA since the last update, both in millicelsius.
+ */
+#define POWER_MODEL_TEMP_WINDOW	1000
+#define POWER_MODEL_TEMP_DELTA	250
+
 #define FRAC_BITS 10
 #define int_to_frac(x) ((x) << FRAC_BITS)
 #define frac_to_int(x) ((x) >> FRAC_BITS)
@@ -329,6 +338,51 @@ static void divvy_up_power(u32 *req_power, u32 *max_power, int num_actors,
 					extra_power) / capped_extra_power;
 }
 
+/**
+ * update_actor_power_models() - feed the power drawn at equilibrium back
+ * @tz:	thermal zone we are operating in
+ * @control_temp:	the target temperature
+ * @req_power:	the power each actor reported drawing over the last period
+ * @total_req_power:	the sum of @req_power
+ *
+ * A zone held at its control temperature dissipates its sustainable
+ * power, which is how the latter is defined.  While the zone is settled
+ * there, share the sustainable power out among the actors in proportion
+ * to what they reported, and pass the shares to the cpu actors' power
+ * models.  This way the estimates the budget is divided by converge on
+ * what is actually drawn, without a power meter.  Zones without a
+ * sustainable-power from the platform are skipped, as the estimated one
+ * is only a lower bound.
+ */
+static void update_actor_power_models(struct thermal_zone_device *tz,
+				      int control_temp, u32 *req_power,
+				      u32 total_req_power)
+{
+	struct power_allocator_params *params = tz->governor_data;
+	u32 sustainable_power = tz->tzp->sustainable_power;
+	struct thermal_instance *instance;
+	int i = 0;
+
+	if (!sustainable_power || !total_req_power ||
+	    abs(tz->temperature - control_temp) > POWER_MODEL_TEMP_WINDOW ||
+	    abs(tz->temperature - tz->last_temperature) >
+	    POWER_MODEL_TEMP_DELTA)
+		return;
+
+	list_for_each_entry(instance, &tz->thermal_instances, tz_node) {
+		if (instance->trip != params->trip_max_desired_temperature)
+			continue;
+
+		if (!cdev_is_power_actor(instance->cdev))
+			continue;
+
+		cpufreq_cooling_update_power(instance->cdev,
+			div_u64((u64)sustainable_power * req_power[i],
+				total_req_power));
+		i++;
+	}
+}
+
 static int allocate_power(struct thermal_zone_device *tz,
 			  int control_temp)
 {
@@ -415,6 +469,8 @@ static int allocate_power(struct thermal_zone_device *tz,
 		i++;
 	}
 
+	update_actor_power_models(tz, control_temp, req_power, total_req_power);
+
 	power_range = pid_controller(tz, control_temp, max_allocatable_power);
 
 	divvy_up_power(weighted_req_power, max_power, num_actors,
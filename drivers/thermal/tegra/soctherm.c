@@ -25,6 +25,7 @@
 #include <linux/io.h>
 #include <linux/irq.h>
 #include <linux/irqdomain.h>
+#include <linux/ktime.h>
 #include <linux/leds.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -87,6 +88,7 @@
 #define THERMCTL_LVL0_CPU0_GPU_THROT_HEAVY	0x2
 #define THERMCTL_LVL0_CPU0_MEM_THROT_MASK	BIT(2)
 #define THERMCTL_LVL0_CPU0_STATUS_MASK		0x3
+#define THERMCTL_LVL0_CPU0_STATUS_HI		0x3
 
 #define THERMCTL_LVL0_UP_STATS			0x10
 #define THERMCTL_LVL0_DN_STATS			0x14
@@ -262,12 +264,25 @@
 /* get THERMCTL_LEVELx offset per CPU/GPU/MEM/TSENSE rg and LEVEL0~3 lv */
 #define THERMCTL_LVL_REGS_SIZE		0x20
 #define THERMCTL_LVL_REG(rg, lv)	((rg) + ((lv) * THERMCTL_LVL_REGS_SIZE))
+/* up/down interrupt bits of level lv of a sensor group */
+#define THERMCTL_LVL_ISR_MASK(sg, lv)	((sg)->thermctl_isr_mask << (2 * (lv)))
 #define OC_THROTTLE_MODE_DISABLED 0
 #define OC_THROTTLE_MODE_BRIEF 2
 
 static const int min_low_temp = -127000;
 static const int max_high_temp = 127000;
 
+/*
+ * Once a zone is interrupt driven, its trips are kept within a window
+ * around the current temperature so that tz->temperature stays fresh
+ * without polling. The window widens while the temperature moves fast,
+ * bounding the interrupt rate, and narrows back once it settles.
+ */
+#define SOCTHERM_WINDOW_MIN		2000	/* mC */
+#define SOCTHERM_WINDOW_MAX		16000	/* mC */
+#define SOCTHERM_WINDOW_FAST_MS		500
+#define SOCTHERM_WINDOW_SLOW_MS		5000
+
 enum soctherm_throttle_id {
 	THROTTLE_LIGHT = 0,
 	THROTTLE_HEAVY,
@@ -311,6 +326,9 @@ struct tegra_thermctl_zone {
 	struct tegra_soctherm *ts;
 	struct thermal_zone_device *tz;
 	const struct tegra_tsensor_group *sg;
+	int window;		/* mC */
+	u64 last_set_trips;	/* ns */
+	int polling_delay;	/* ms, as requested by DT */
 };
 
 struct soctherm_oc_cfg {
@@ -323,6 +341,12 @@ struct soctherm_oc_cfg {
 	u64 oc_cnt;
 };
 
+struct soctherm_throt_stats {
+	u64 count;
+	u64 time_ns;
+	u64 since;	/* ns, 0 while not engaged */
+};
+
 struct soctherm_throt_cfg {
 	struct soctherm_oc_cfg oc_cfg;
 	const char *name;
@@ -333,6 +357,7 @@ struct soctherm_throt_cfg {
 	struct thermal_cooling_device *cdev;
 	bool init;
 	u8 priority;
+	struct soctherm_throt_stats stats[THROTTLE_DEV_SIZE];
 };
 
 struct tegra_soctherm {
@@ -350,6 +375,9 @@ struct tegra_soctherm {
 	struct dentry *debugfs_dir;
 	int thermal_irq;
 	int edp_irq;
+	bool irq_driven;
+	u32 throt_irq_mask;
+	struct mutex throt_stats_lock;
 };
 
 struct soctherm_oc_irq_chip_data {
@@ -367,6 +395,7 @@ struct tsensor_hw_pllx_offset {
 
 static struct soctherm_oc_irq_chip_data soc_irq_cdata;
 static struct tsensor_hw_pllx_offset hw_pllx;
+static struct tegra_thermctl_zone *mem_zone;
 static DEFINE_SPINLOCK(soctherm_lock);
 static void throttlectl_cpu_mn(struct tegra_soctherm *ts,
 			       enum soctherm_throttle_id throt);
@@ -710,11 +739,61 @@ static void thermal_irq_disable(struct tegra_thermctl_zone *zn)
 	mutex_unlock(&zn->ts->thermctl_lock);
 }
 
+/*
+ * Called with tz->lock held from thermal_zone_device_update(), so
+ * tz->temperature is the reading the trips are being placed around.
+ */
+static void tegra_thermctl_window_trips(struct tegra_thermctl_zone *zone,
+					int *lo, int *hi)
+{
+	struct thermal_zone_device *tz = zone->tz;
+	u64 now = ktime_get_ns();
+	u64 delta_ms = div_u64(now - zone->last_set_trips, NSEC_PER_MSEC);
+
+	zone->last_set_trips = now;
+
+	/* While passive cooling polls the zone the rate says nothing */
+	if (!tz->passive) {
+		if (delta_ms < SOCTHERM_WINDOW_FAST_MS)
+			zone->window = min(zone->window * 2,
+					   SOCTHERM_WINDOW_MAX);
+		else if (delta_ms > SOCTHERM_WINDOW_SLOW_MS)
+			zone->window = max(zone->window / 2,
+					   SOCTHERM_WINDOW_MIN);
+	}
+
+	*lo = max(*lo, tz->temperature - zone->window);
+	*hi = min(*hi, tz->temperature + zone->window);
+}
+
+/*
+ * Only step_wise raises tz->passive, which makes the core poll the zone
+ * at passive-delay while it is cooled. Other governors such as
+ * power_allocator rely on the regular polling to run at all, so their
+ * zones keep the polling delay requested by DT.
+ */
+static bool tegra_thermctl_irq_driven(struct tegra_thermctl_zone *zone)
+{
+	struct thermal_zone_device *tz = zone->tz;
+
+	return zone->ts->irq_driven && tz && tz->governor &&
+	       !strncasecmp(tz->governor->name, "step_wise",
+			    THERMAL_NAME_LENGTH);
+}
+
 static int tegra_thermctl_set_trips(void *data, int lo, int hi)
 {
 	struct tegra_thermctl_zone *zone = data;
 	u32 r;
 
+	/* The governor can change at runtime, so decide on every update */
+	if (tegra_thermctl_irq_driven(zone)) {
+		zone->tz->polling_delay = 0;
+		tegra_thermctl_window_trips(zone, &lo, &hi);
+	} else if (zone->tz) {
+		zone->tz->polling_delay = zone->polling_delay;
+	}
+
 	thermal_irq_disable(zone);
 
 	r = readl(zone->ts->regs + zone->sg->thermctl_lvl0_offset);
@@ -801,6 +880,85 @@ static int get_hot_temp(struct thermal_zone_device *tz, int *trip, int *temp)
 	return -EINVAL;
 }
 
+static bool throt_applies_to(struct soctherm_throt_cfg *stc,
+			     enum soctherm_throttle_dev_id dev)
+{
+	if (dev == THROTTLE_DEV_CPU)
+		return stc->cpu_throt_level || stc->cpu_throt_depth;
+
+	return stc->gpu_throt_level;
+}
+
+/**
+ * soctherm_throttle_stats_update() - account HW throttle engagements
+ * @ts: pointer to a struct tegra_soctherm
+ *
+ * A LIGHT or HEAVY throttle is engaged while any sensor group is above
+ * the level it was programmed on by throttrip_program(). Closes or opens
+ * the engagement periods of the CPU and GPU halves of each throttle
+ * according to the current level status.
+ */
+static void soctherm_throttle_stats_update(struct tegra_soctherm *ts)
+{
+	const struct tegra_tsensor_group *sg;
+	struct soctherm_throt_cfg *stc;
+	struct soctherm_throt_stats *st;
+	u64 now = ktime_get_ns();
+	bool engaged;
+	int i, throt, dev;
+	u32 r;
+
+	mutex_lock(&ts->throt_stats_lock);
+
+	for (throt = THROTTLE_LIGHT; throt < THROTTLE_OC1; throt++) {
+		stc = &ts->throt_cfgs[throt];
+		if (!stc->init)
+			continue;
+
+		engaged = false;
+		for (i = 0; i < ts->soc->num_ttgs; i++) {
+			sg = ts->soc->ttgs[i];
+			r = readl(ts->regs +
+				  THERMCTL_LVL_REG(sg->thermctl_lvl0_offset,
+						   throt + 1));
+			if (REG_GET_MASK(r, THERMCTL_LVL0_CPU0_EN_MASK) &&
+			    REG_GET_MASK(r, THERMCTL_LVL0_CPU0_STATUS_MASK) ==
+			    THERMCTL_LVL0_CPU0_STATUS_HI)
+				engaged = true;
+		}
+
+		for (dev = 0; dev < THROTTLE_DEV_SIZE; dev++) {
+			if (!throt_applies_to(stc, dev))
+				continue;
+
+			st = &stc->stats[dev];
+			if (st->since) {
+				st->time_ns += now - st->since;
+				st->since = engaged ? now : 0;
+			} else if (engaged) {
+				st->count++;
+				st->since = now;
+			}
+		}
+	}
+
+	mutex_unlock(&ts->throt_stats_lock);
+}
+
+static void throttrip_irq_enable(struct tegra_soctherm *ts,
+				 const struct tegra_tsensor_group *sg,
+				 struct soctherm_throt_cfg *stc)
+{
+	u32 mask = THERMCTL_LVL_ISR_MASK(sg, stc->id + 1);
+	u32 r;
+
+	mutex_lock(&ts->thermctl_lock);
+	ts->throt_irq_mask |= mask;
+	r = readl(ts->regs + THERMCTL_INTR_EN);
+	writel(r | mask, ts->regs + THERMCTL_INTR_EN);
+	mutex_unlock(&ts->thermctl_lock);
+}
+
 /**
  * tegra_soctherm_set_hwtrips() - set HW trip point from DT data
  * @dev: struct device * of the SOC_THERM instance
@@ -870,6 +1028,8 @@ static int tegra_soctherm_set_hwtrips(struct device *dev,
 			return ret;
 		}
 
+		throttrip_irq_enable(ts, sg, stc);
+
 		dev_info(dev,
 			 "throttrip: will throttle when %s reaches %d mC\n",
 			 sg->name, temperature);
@@ -923,10 +1083,24 @@ static irqreturn_t soctherm_thermal_isr_thread(int irq, void *dev_id)
 {
 	struct tegra_soctherm *ts = dev_id;
 	struct thermal_zone_device *tz;
-	u32 st, ex = 0, cp = 0, gp = 0, pl = 0, me = 0;
+	u32 st, ex = 0, cp = 0, gp = 0, pl = 0, me = 0, th, r;
 
 	st = readl(ts->regs + THERMCTL_INTR_STATUS);
 
+	/* HW throttle levels crossed: account and re-arm them */
+	th = st & ts->throt_irq_mask;
+	if (th) {
+		writel(th, ts->regs + THERMCTL_INTR_STATUS);
+		st &= ~th;
+
+		soctherm_throttle_stats_update(ts);
+
+		mutex_lock(&ts->thermctl_lock);
+		r = readl(ts->regs + THERMCTL_INTR_EN);
+		writel(r | th, ts->regs + THERMCTL_INTR_EN);
+		mutex_unlock(&ts->thermctl_lock);
+	}
+
 	/* deliberately clear expected interrupts handled in SW */
 	cp |= st & TH_INTR_CD0_MASK;
 	cp |= st & TH_INTR_CU0_MASK;
@@ -2544,6 +2718,32 @@ static void tegra_soctherm_throttle(struct device *dev)
 	writel(v, ts->regs + THERMCTL_STATS_CTL);
 }
 
+/**
+ * soctherm_zones_irq_driven() - stop polling the step_wise sensor group zones
+ * @ts: pointer to a struct tegra_soctherm
+ *
+ * With the thermal interrupt in place, every temperature change of
+ * interest raises an interrupt through the trips programmed by
+ * tegra_thermctl_set_trips(), so the periodic polling requested by DT
+ * only costs wakeups. tegra_thermctl_set_trips() drops it for the zones
+ * whose governor polls at passive-delay while cooling.
+ */
+static void soctherm_zones_irq_driven(struct tegra_soctherm *ts)
+{
+	struct thermal_zone_device *tz;
+	int i;
+
+	ts->irq_driven = true;
+
+	for (i = 0; i < ts->soc->num_ttgs; i++) {
+		tz = ts->thermctl_tzs[ts->soc->ttgs[i]->id];
+		if (!tz)
+			continue;
+
+		thermal_zone_device_update(tz, THERMAL_EVENT_UNSPECIFIED);
+	}
+}
+
 static int soctherm_interrupts_init(struct platform_device *pdev,
 				    struct tegra_soctherm *tegra)
 {
@@ -2580,6 +2780,8 @@ static int soctherm_interrupts_init(struct platform_device *pdev,
 		return ret;
 	}
 
+	soctherm_zones_irq_driven(tegra);
+
 	ret = devm_request_threaded_irq(&pdev->dev,
 					tegra->edp_irq,
 					soctherm_edp_isr,
@@ -2639,6 +2841,26 @@ void tegra_soctherm_gpu_tsens_invalidate(bool low_voltage_range)
 }
 EXPORT_SYMBOL_GPL(tegra_soctherm_gpu_tsens_invalidate);
 
+/**
+ * tegra_soctherm_get_mem_temp() - read the MEM sensor group temperature
+ * @temp:	the temperature in millicelsius
+ *
+ * Reads the SOC_THERM readback register directly, without going through
+ * the thermal core, so it is cheap and safe to call from atomic context.
+ *
+ * Return: 0 on success, -ENODEV if the MEM sensor is not available.
+ */
+int tegra_soctherm_get_mem_temp(int *temp)
+{
+	struct tegra_thermctl_zone *zone = READ_ONCE(mem_zone);
+
+	if (!zone)
+		return -ENODEV;
+
+	return tegra_thermctl_get_temp(zone, temp);
+}
+EXPORT_SYMBOL_GPL(tegra_soctherm_get_mem_temp);
+
 static void soctherm_hw_pllx_offsets_init(struct tegra_soctherm *tegra)
 {
 	const struct tegra_tsensor_group *ttg;
@@ -2732,6 +2954,57 @@ static void soctherm_oc_counter_init(struct platform_device *pdev)
 	device_create_file(&pdev->dev, &dev_attr_oc_stats);
 }
 
+static const char *const throt_dev_names[] = {
+	[THROTTLE_DEV_CPU] = "cpu",
+	[THROTTLE_DEV_GPU] = "gpu",
+};
+
+static ssize_t show_throttle_stats_sysfs(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct tegra_soctherm *ts = dev_get_drvdata(dev);
+	struct soctherm_throt_cfg *stc;
+	struct soctherm_throt_stats *st;
+	ssize_t len = 0;
+	u64 now, time_ns;
+	int throt, d;
+
+	if (!ts)
+		return -EINVAL;
+
+	/* close the running periods so they are included */
+	soctherm_throttle_stats_update(ts);
+	now = ktime_get_ns();
+
+	mutex_lock(&ts->throt_stats_lock);
+	for (throt = THROTTLE_LIGHT; throt < THROTTLE_OC1; throt++) {
+		stc = &ts->throt_cfgs[throt];
+		if (!stc->init)
+			continue;
+
+		for (d = 0; d < THROTTLE_DEV_SIZE; d++) {
+			if (!throt_applies_to(stc, d))
+				continue;
+
+			st = &stc->stats[d];
+			time_ns = st->time_ns;
+			if (st->since)
+				time_ns += now - st->since;
+
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 "%s %s: count %llu time_ms %llu\n",
+					 throt_names[throt],
+					 throt_dev_names[d], st->count,
+					 div_u64(time_ns, NSEC_PER_MSEC));
+		}
+	}
+	mutex_unlock(&ts->throt_stats_lock);
+
+	return len;
+}
+
+static DEVICE_ATTR(throttle_stats, S_IRUGO, show_throttle_stats_sysfs, NULL);
+
 static const struct of_device_id tegra_soctherm_of_match[] = {
 #ifdef CONFIG_ARCH_TEGRA_124_SOC
 	{
@@ -2783,6 +3056,7 @@ static int tegra_soctherm_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	mutex_init(&tegra->thermctl_lock);
+	mutex_init(&tegra->throt_stats_lock);
 	dev_set_drvdata(&pdev->dev, tegra);
 
 	tegra->soc = soc;
@@ -2862,6 +3136,7 @@ static int tegra_soctherm_probe(struct platform_device *pdev)
 	soctherm_init(pdev);
 	soctherm_debug_init(pdev);
 	soctherm_oc_counter_init(pdev);
+	device_create_file(&pdev->dev, &dev_attr_throttle_stats);
 
 	for (i = 0; i < soc->num_ttgs; ++i) {
 		struct tegra_thermctl_zone *zone =
@@ -2875,6 +3150,7 @@ static int tegra_soctherm_probe(struct platform_device *pdev)
 		zone->dev = &pdev->dev;
 		zone->sg = soc->ttgs[i];
 		zone->ts = tegra;
+		zone->window = SOCTHERM_WINDOW_MIN;
 		soctherm_debug_temp_add(zone);
 
 		z = devm_thermal_zone_of_sensor_register(&pdev->dev,
@@ -2888,7 +3164,10 @@ static int tegra_soctherm_probe(struct platform_device *pdev)
 		}
 
 		zone->tz = z;
+		zone->polling_delay = z->polling_delay;
 		tegra->thermctl_tzs[soc->ttgs[i]->id] = z;
+		if (soc->ttgs[i]->id == TEGRA124_SOCTHERM_SENSOR_MEM)
+			WRITE_ONCE(mem_zone, zone);
 
 		/* Configure hw trip points */
 		err = tegra_soctherm_set_hwtrips(&pdev->dev, soc->ttgs[i], z);
@@ -2901,6 +3180,7 @@ static int tegra_soctherm_probe(struct platform_device *pdev)
 	return err;
 
 disable_clocks:
+	WRITE_ONCE(mem_zone, NULL);
 	soctherm_clk_enable(pdev, false);
 
 	return err;
@@ -2910,6 +3190,7 @@ static int tegra_soctherm_remove(struct platform_device *pdev)
 {
 	struct tegra_soctherm *tegra = platform_get_drvdata(pdev);
 
+	WRITE_ONCE(mem_zone, NULL);
 	debugfs_remove_recursive(tegra->debugfs_dir);
 
 	soctherm_clk_enable(pdev, false);
@@ -83,6 +83,14 @@ of_cpufreq_power_cooling_register(struct device_node *np,
 void cpufreq_cooling_unregister(struct thermal_cooling_device *cdev);
 
 unsigned long cpufreq_cooling_get_level(unsigned int cpu, unsigned int freq);
+
+/**
+ * cpufreq_cooling_update_power - feed measured cpu power to the power model.
+ * @cdev: thermal cooling device registered with power extensions.
+ * @power: average power drawn by its cpus since the last call, in mW.
+ */
+void cpufreq_cooling_update_power(struct thermal_cooling_device *cdev,
+				  u32 power);
 #else /* !CONFIG_CPU_THERMAL */
 static inline struct thermal_cooling_device *
 cpufreq_cooling_register(const struct cpumask *clip_cpus)
@@ -122,6 +130,11 @@ unsigned long cpufreq_cooling_get_level(unsigned int cpu, unsigned int freq)
 {
 	return THERMAL_CSTATE_INVALID;
 }
+static inline
+void cpufreq_cooling_update_power(struct thermal_cooling_device *cdev,
+				  u32 power)
+{
+}
 #endif	/* CONFIG_CPU_THERMAL */
 
 #endif /* __CPU_COOLING_H__ */
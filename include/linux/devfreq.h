@@ -173,6 +173,7 @@ struct devfreq_governor {
  * @time_in_state:	Statistics of devfreq states
  * @last_stat_updated:	The last time stat updated
  * @transition_notifier_list: list head of DEVFREQ_TRANSITION_NOTIFIER notifier
+ * @debug:	target() latency and governor decision statistics in debugfs
  *
  * This structure stores the devfreq information for a give device.
  *
@@ -211,6 +212,10 @@ struct devfreq {
 	struct srcu_notifier_head transition_notifier_list;
 
 	bool suspended;
+
+#ifdef CONFIG_DEBUG_FS
+	struct devfreq_debug *debug;
+#endif
 };
 
 struct devfreq_freqs {
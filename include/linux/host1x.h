@@ -20,6 +20,7 @@
 #define __LINUX_HOST1X_H
 
 #include <linux/device.h>
+#include <linux/ktime.h>
 #include <linux/types.h>
 
 enum host1x_class {
@@ -219,6 +220,10 @@ struct host1x_job {
 	unsigned int first_get;
 	unsigned int num_slots;
 
+	/* Time of submission and of the CDMA kick, for latency stats */
+	ktime_t submit_ktime;
+	ktime_t push_ktime;
+
 	/* Copy of gathers */
 	size_t gather_copy_size;
 	dma_addr_t gather_copy;
@@ -692,6 +692,19 @@ static inline void init_irq_proc(void)
 }
 #endif
 
+#ifdef CONFIG_IRQ_TIMINGS
+extern void irq_timings_enable(void);
+extern void irq_timings_disable(void);
+extern u64 irq_timings_next_event(u64 now);
+#else
+static inline void irq_timings_enable(void) { }
+static inline void irq_timings_disable(void) { }
+static inline u64 irq_timings_next_event(u64 now)
+{
+	return U64_MAX;
+}
+#endif
+
 struct seq_file;
 int show_interrupts(struct seq_file *p, void *v);
 int arch_show_interrupts(struct seq_file *p, int prec);
@@ -25,14 +25,17 @@ struct iova {
 
 struct iova_magazine;
 struct iova_cpu_rcache;
+struct iova_depot;
 
-#define IOVA_RANGE_CACHE_MAX_SIZE 6	/* log of max cached IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_MAX_SIZE 11	/* log of max cached IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_LARGE_SIZE 6	/* log of first size with a trimmed cache */
 #define MAX_GLOBAL_MAGS 32	/* magazines per bin */
 
 struct iova_rcache {
-	spinlock_t lock;
-	unsigned long depot_size;
-	struct iova_magazine *depot[MAX_GLOBAL_MAGS];
+	unsigned long mag_size;		/* pfns per magazine */
+	unsigned long depot_max;	/* magazines per depot */
+	unsigned int nr_depots;
+	struct iova_depot *depots;	/* one per CPU cluster */
 	struct iova_cpu_rcache __percpu *cpu_rcaches;
 };
 
@@ -918,6 +918,9 @@ struct sched_info {
 	/* timestamps */
 	unsigned long long last_arrival,/* when we last ran on a cpu */
 			   last_queued;	/* when we were last queued to run */
+
+	/* last queued on being preempted rather than on wakeup */
+	unsigned int last_queued_preempt;
 };
 #endif /* CONFIG_SCHED_INFO */
 
@@ -1107,11 +1110,38 @@ struct idle_state {
 	unsigned long power;	 /* power consumption in this idle state */
 };
 
+/*
+ * Utilization is bucketed in steps of 1 << SGE_CAP_LUT_SHIFT to index
+ * sched_energy_lut::ent.
+ */
+#define SGE_CAP_LUT_SHIFT	4
+#define SGE_CAP_LUT_SIZE	((SCHED_CAPACITY_SCALE >> SGE_CAP_LUT_SHIFT) + 1)
+
+struct sched_group_energy;
+
+/*
+ * Per utilization bucket, the lowest capacity state able to serve the
+ * bottom of the bucket and the busy power of the group in that state.
+ * For a cluster, @core is the energy data of its cores and @core_power
+ * their busy power in the same state, valid if @core_valid.
+ */
+struct sched_energy_lut {
+	const struct sched_group_energy *core;
+	bool core_valid;		/* @core has the same cap_states */
+	struct {
+		unsigned int cap;
+		unsigned int power;
+		unsigned int core_power;
+		u8 idx;			/* index into cap_states */
+	} ent[SGE_CAP_LUT_SIZE];
+};
+
 struct sched_group_energy {
 	unsigned int nr_idle_states;	/* number of idle states */
 	struct idle_state *idle_states;	/* ptr to idle state array */
 	unsigned int nr_cap_states;	/* number of capacity states */
 	struct capacity_state *cap_states; /* ptr to capacity state array */
+	struct sched_energy_lut *lut;	/* util bucket lookup, optional */
 };
 
 unsigned long capacity_curr_of(int cpu);
@@ -1126,6 +1156,7 @@ struct eas_stats {
 	u64 sis_suff_cap;
 	u64 sis_idle_cpu;
 	u64 sis_count;
+	u64 sis_scanned;	/* CPUs examined by select_idle_cpu() */
 
 	/* select_energy_cpu_brute() stats */
 	u64 secb_attempts;
@@ -1136,12 +1167,15 @@ struct eas_stats {
 	u64 secb_nrg_sav;
 	u64 secb_count;
 
+	u64 secb_nrg_time;	/* ns spent in energy estimation */
+
 	/* find_best_target() stats */
 	u64 fbt_attempts;
 	u64 fbt_no_cpu;
 	u64 fbt_no_sd;
 	u64 fbt_pref_idle;
 	u64 fbt_count;
+	u64 fbt_time;		/* ns spent searching for a target */
 
 	/* cas */
 	/* select_task_rq_fair() stats */
@@ -1153,8 +1187,23 @@ struct sched_domain_shared {
 	atomic_t	ref;
 	atomic_t	nr_busy_cpus;
 	int		has_idle_cores;
+
+	/*
+	 * Hint of the CPUs in the domain that are idle: set on idle entry,
+	 * cleared on idle exit or when found busy by a wakeup scan.
+	 *
+	 * NOTE: this field is variable length. (Allocated dynamically
+	 * by attaching extra space to the end of the structure,
+	 * depending on how many CPUs the kernel has booted up with)
+	 */
+	unsigned long	idle_cpus_span[0];
 };
 
+static inline struct cpumask *sds_idle_cpus(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_cpus_span);
+}
+
 struct sched_domain {
 	/* These fields must be setup */
 	struct sched_domain *parent;	/* top domain must be null terminated */
@@ -1461,6 +1510,7 @@ struct sched_statistics {
 
 #ifdef CONFIG_SCHED_WALT
 #define RAVG_HIST_SIZE_MAX  5
+#define NUM_BUSY_BUCKETS 10
 
 /* ravg represents frequency scaled cpu-demand of tasks */
 struct ravg {
@@ -1485,12 +1535,21 @@ struct ravg {
 	 *
 	 * 'prev_window' represents task's contribution to cpu busy time
 	 * statistics (rq->prev_runnable_sum) in previous window
+	 *
+	 * 'pred_demand' represents task's predicted cpu busy time in the
+	 * next window, picked from 'busy_buckets'
+	 *
+	 * 'busy_buckets' groups historical busy time into NUM_BUSY_BUCKETS
+	 * equal slices of the window; the count for a slice rises each time
+	 * a window's busy time falls into it and decays otherwise
 	 */
 	u64 mark_start;
 	u32 sum, demand;
 	u32 sum_history[RAVG_HIST_SIZE_MAX];
 	u32 curr_window, prev_window;
 	u16 active_windows;
+	u32 pred_demand;
+	u8 busy_buckets[NUM_BUSY_BUCKETS];
 };
 #endif
 
@@ -3739,15 +3798,34 @@ extern struct task_group root_task_group;
 extern int task_can_switch_user(struct user_struct *up,
 					struct task_struct *tsk);
 
+#ifdef CONFIG_UID_SYS_STATS
+enum uid_io_stat {
+	UID_IO_RCHAR,
+	UID_IO_WCHAR,
+	UID_IO_READ_BYTES,
+	UID_IO_WRITE_BYTES,
+	UID_IO_CANCELLED_WRITE_BYTES,
+	UID_IO_FSYNC,
+	UID_IO_NR_STATS,
+};
+
+extern void uid_io_account(enum uid_io_stat stat, u64 amt);
+#else
+#define uid_io_account(stat, amt)	do { } while (0)
+#endif
+
 #ifdef CONFIG_TASK_XACCT
+/* The rchar, wchar and syscfs counters are only updated for current */
 static inline void add_rchar(struct task_struct *tsk, ssize_t amt)
 {
 	tsk->ioac.rchar += amt;
+	uid_io_account(UID_IO_RCHAR, amt);
 }
 
 static inline void add_wchar(struct task_struct *tsk, ssize_t amt)
 {
 	tsk->ioac.wchar += amt;
+	uid_io_account(UID_IO_WCHAR, amt);
 }
 
 static inline void inc_syscr(struct task_struct *tsk)
@@ -3763,6 +3841,7 @@ static inline void inc_syscw(struct task_struct *tsk)
 static inline void inc_syscfs(struct task_struct *tsk)
 {
 	tsk->ioac.syscfs++;
+	uid_io_account(UID_IO_FSYNC, 1);
 }
 #else
 static inline void add_rchar(struct task_struct *tsk, ssize_t amt)
@@ -3834,6 +3913,7 @@ void cpufreq_add_update_util_hook(int cpu, struct update_util_data *data,
                        void (*func)(struct update_util_data *data, u64 time,
 				    unsigned int flags));
 void cpufreq_remove_update_util_hook(int cpu);
+unsigned long cpufreq_get_util(u64 time, unsigned long *max);
 #endif /* CONFIG_CPU_FREQ */
 
 #endif
@@ -34,10 +34,12 @@
 extern struct sched_group_energy *sge_array[NR_CPUS][NR_SD_LEVELS];
 
 void init_sched_energy_costs(void);
+void sched_energy_update_luts(void);
 
 #else
 
 #define init_sched_energy_costs() do { } while (0)
+#define sched_energy_update_luts() do { } while (0)
 
 #endif /* CONFIG_SMP */
 
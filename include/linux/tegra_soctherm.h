@@ -22,4 +22,13 @@
 void tegra_soctherm_gpu_tsens_invalidate(bool control);
 void tegra_soctherm_cpu_tsens_invalidate(bool control);
 
+#if IS_ENABLED(CONFIG_TEGRA_SOCTHERM)
+int tegra_soctherm_get_mem_temp(int *temp);
+#else
+static inline int tegra_soctherm_get_mem_temp(int *temp)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif /* __TEGRA_SOCTHERM_H */
@@ -37,6 +37,7 @@ extern int tegra_dfll_get_thermal_index(struct tegra_dfll *td,
 extern int tegra_dfll_count_thermal_states(struct tegra_dfll *td,
 			enum tegra_dfll_thermal_type type);
 int tegra_dfll_set_external_floor_mv(int external_floor_mv);
+int tegra_dfll_fast_set_rate(unsigned long rate);
 u32 tegra_dfll_get_thermal_floor_mv(void);
 u32 tegra_dfll_get_peak_thermal_floor_mv(void);
 u32 tegra_dfll_get_thermal_cap_mv(void);
@@ -94,6 +94,9 @@ const struct emc_clk_ops *tegra210_emc_get_ops(void);
 int tegra210_emc_get_dram_temp(void);
 int tegra210_emc_set_over_temp_state(unsigned long state);
 void tegra210_emc_mr4_set_freq_thresh(unsigned long thresh);
+unsigned long tegra210_emc_bw_to_rate(unsigned long total_bw,
+				      unsigned long iso_bw, u32 usage_flags);
+unsigned int tegra210_emc_get_clk_latency(unsigned long rate);
 #else
 static inline void tegra210_emc_timing_invalidate(void) { return; }
 static inline bool tegra210_emc_is_ready(void) { return true; }
@@ -105,6 +108,20 @@ static inline int tegra210_emc_get_dram_temp(void) {return -ENODEV; }
 static inline int tegra210_emc_set_over_temp_state(unsigned long state)
 { return -ENODEV; }
 static inline void tegra210_emc_mr4_set_freq_thresh(unsigned long thresh) { }
+static inline unsigned long tegra210_emc_bw_to_rate(unsigned long total_bw,
+		unsigned long iso_bw, u32 usage_flags)
+{ return 0; }
+static inline unsigned int tegra210_emc_get_clk_latency(unsigned long rate)
+{ return 0; }
+#endif
+
+#if IS_REACHABLE(CONFIG_ARM_TEGRA_DEVFREQ)
+int tegra_emc_request_bw(enum emc_user_id user, unsigned long avg_bw,
+			 unsigned long peak_bw);
+#else
+static inline int tegra_emc_request_bw(enum emc_user_id user,
+		unsigned long avg_bw, unsigned long peak_bw)
+{ return 0; }
 #endif
 
 #endif
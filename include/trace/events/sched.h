@@ -1041,6 +1041,7 @@ TRACE_EVENT(walt_update_history,
 		__field(	 int,	samples			)
 		__field(	 int,	evt			)
 		__field(	 u64,	demand			)
+		__field(	 u64,	pred_demand		)
 		__field(	 u64,	walt_avg		)
 		__field(unsigned int,	pelt_avg		)
 		__array(	 u32,	hist, RAVG_HIST_SIZE_MAX)
@@ -1054,6 +1055,7 @@ TRACE_EVENT(walt_update_history,
 		__entry->samples        = samples;
 		__entry->evt            = evt;
 		__entry->demand         = p->ravg.demand;
+		__entry->pred_demand    = p->ravg.pred_demand;
 		__entry->walt_avg	= (__entry->demand << SCHED_CAPACITY_SHIFT);
 		__entry->walt_avg	= div_u64(__entry->walt_avg,
 						  walt_ravg_window);
@@ -1064,10 +1066,11 @@ TRACE_EVENT(walt_update_history,
 	),
 
 	TP_printk("%d (%s): runtime %u samples %d event %d demand %llu"
-		" walt %llu pelt %u (hist: %u %u %u %u %u) cpu %d",
+		" pred_demand %llu walt %llu pelt %u (hist: %u %u %u %u %u)"
+		" cpu %d",
 		__entry->pid, __entry->comm,
 		__entry->runtime, __entry->samples, __entry->evt,
-		__entry->demand,
+		__entry->demand, __entry->pred_demand,
 		__entry->walt_avg,
 		__entry->pelt_avg,
 		__entry->hist[0], __entry->hist[1],
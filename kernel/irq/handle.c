@@ -182,6 +182,8 @@ irqreturn_t handle_irq_event_percpu(struct irq_desc *desc)
 	irqreturn_t retval;
 	unsigned int flags = 0;
 
+	record_irq_time(desc);
+
 	retval = __handle_irq_event_percpu(desc, &flags);
 
 	add_interrupt_randomness(desc->irq_data.irq, flags);
@@ -6,6 +6,7 @@
  * of this file for your non core code.
  */
 #include <linux/irqdesc.h>
+#include <linux/jump_label.h>
 #include <linux/kernel_stat.h>
 #include <linux/pm_runtime.h>
 
@@ -47,6 +48,7 @@ enum {
  * IRQS_WAITING			- irq is waiting
  * IRQS_PENDING			- irq is pending and replayed later
  * IRQS_SUSPENDED		- irq is suspended
+ * IRQS_TIMINGS			- irq has a non-timer action, record its timings
  */
 enum {
 	IRQS_AUTODETECT		= 0x00000001,
@@ -57,6 +59,7 @@ enum {
 	IRQS_WAITING		= 0x00000080,
 	IRQS_PENDING		= 0x00000200,
 	IRQS_SUSPENDED		= 0x00000800,
+	IRQS_TIMINGS		= 0x00001000,
 };
 
 #include "debug.h"
@@ -88,6 +91,21 @@ irqreturn_t __handle_irq_event_percpu(struct irq_desc *desc, unsigned int *flags
 irqreturn_t handle_irq_event_percpu(struct irq_desc *desc);
 irqreturn_t handle_irq_event(struct irq_desc *desc);
 
+#ifdef CONFIG_IRQ_TIMINGS
+DECLARE_STATIC_KEY_FALSE(irq_timing_enabled);
+
+void __irq_timings_record(unsigned int irq, u64 ts);
+
+static inline void record_irq_time(struct irq_desc *desc)
+{
+	if (static_branch_unlikely(&irq_timing_enabled) &&
+	    desc->istate & IRQS_TIMINGS)
+		__irq_timings_record(irq_desc_get_irq(desc), local_clock());
+}
+#else
+static inline void record_irq_time(struct irq_desc *desc) { }
+#endif
+
 /* Resending of interrupts :*/
 void check_irq_resend(struct irq_desc *desc);
 bool irq_wait_for_poll(struct irq_desc *desc);
@@ -1366,6 +1366,13 @@ __setup_irq(unsigned int irq, struct irq_desc *desc, struct irqaction *new)
 
 	irq_pm_install_action(desc, new);
 
+	/*
+	 * Timer interrupts are already accounted for by the next timer
+	 * event; a periodic tick must not look like a regular device line.
+	 */
+	if (!(new->flags & IRQF_TIMER))
+		desc->istate |= IRQS_TIMINGS;
+
 	/* Reset broken irq detection when installing new handler */
 	desc->irq_count = 0;
 	desc->irqs_unhandled = 0;
@@ -1509,6 +1516,7 @@ static struct irqaction *__free_irq(unsigned int irq, void *dev_id)
 		irq_settings_clr_disable_unlazy(desc);
 		irq_shutdown(desc);
 		irq_release_resources(desc);
+		desc->istate &= ~IRQS_TIMINGS;
 	}
 
 #ifdef CONFIG_SMP
@@ -1876,6 +1884,7 @@ static struct irqaction *__free_percpu_irq(unsigned int irq, void __percpu *dev_
 
 	/* Found it - now remove it from the list of entries: */
 	desc->action = NULL;
+	desc->istate &= ~IRQS_TIMINGS;
 
 	raw_spin_unlock_irqrestore(&desc->lock, flags);
 
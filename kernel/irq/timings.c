@@ -0,0 +1,157 @@
+/*
+ * Interrupt arrival timings, for predicting device wakeups from idle.
+ *
+ * Every CPU keeps a small table of the interrupt lines it recently
+ * handled. Per line the arrival interval is tracked as an exponentially
+ * weighted average together with its mean absolute deviation. Lines
+ * that fire at a regular rate (audio DMA periods, touch controllers
+ * scanning, modem paging) yield a prediction of their next arrival,
+ * which idle governors can weigh against the next timer event.
+ *
+ * The table is only touched from hard interrupt context on its own CPU
+ * and read from the idle path with interrupts disabled, so no locking
+ * is needed.
+ */
+#include <linux/kernel.h>
+#include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/static_key.h>
+#include <linux/time64.h>
+
+#include "internals.h"
+
+/* Interrupt lines tracked per CPU */
+#define IRQT_SLOTS		8
+/* Intervals seen before a line's prediction is trusted */
+#define IRQT_MIN_SAMPLES	4
+/* Longer gaps break a sequence, it will be learnt again from scratch */
+#define IRQT_MAX_INTERVAL	NSEC_PER_SEC
+/* EWMA weights, as shifts: 1/8 for the average, 1/4 for the deviation */
+#define IRQT_AVG_SHIFT		3
+#define IRQT_DEV_SHIFT		2
+
+struct irqt_stat {
+	unsigned int	irq;
+	unsigned int	count;
+	u64		last_ts;
+	u64		avg;
+	u64		dev;
+};
+
+struct irq_timings {
+	struct irqt_stat	stat[IRQT_SLOTS];
+};
+
+DEFINE_STATIC_KEY_FALSE(irq_timing_enabled);
+
+static DEFINE_PER_CPU(struct irq_timings, irq_timings);
+
+void irq_timings_enable(void)
+{
+	static_branch_enable(&irq_timing_enabled);
+}
+
+void irq_timings_disable(void)
+{
+	static_branch_disable(&irq_timing_enabled);
+}
+
+static struct irqt_stat *irqt_find_stat(struct irq_timings *irqt,
+					unsigned int irq)
+{
+	struct irqt_stat *s, *victim = &irqt->stat[0];
+	int i;
+
+	for (i = 0; i < IRQT_SLOTS; i++) {
+		s = &irqt->stat[i];
+		if (s->count && s->irq == irq)
+			return s;
+		/* Recycle an unused slot, else the least recently used */
+		if (!s->count || (victim->count && s->last_ts < victim->last_ts))
+			victim = s;
+	}
+
+	victim->irq = irq;
+	victim->count = 0;
+
+	return victim;
+}
+
+void __irq_timings_record(unsigned int irq, u64 ts)
+{
+	struct irqt_stat *s = irqt_find_stat(this_cpu_ptr(&irq_timings), irq);
+	u64 interval, diff;
+
+	if (!s->count)
+		goto out;
+
+	interval = ts - s->last_ts;
+	if (interval > IRQT_MAX_INTERVAL) {
+		s->count = 0;
+		goto out;
+	}
+
+	if (s->count == 1) {
+		s->avg = interval;
+		s->dev = 0;
+		goto out;
+	}
+
+	if (interval > s->avg) {
+		diff = interval - s->avg;
+		s->avg += diff >> IRQT_AVG_SHIFT;
+	} else {
+		diff = s->avg - interval;
+		s->avg -= diff >> IRQT_AVG_SHIFT;
+	}
+	s->dev += (diff >> IRQT_DEV_SHIFT) - (s->dev >> IRQT_DEV_SHIFT);
+out:
+	s->last_ts = ts;
+	if (s->count < UINT_MAX)
+		s->count++;
+}
+
+/**
+ * irq_timings_next_event - predict the next interrupt on this CPU
+ * @now: current time, in local_clock() nanoseconds
+ *
+ * Must be called with interrupts disabled.
+ *
+ * Returns the earliest expected arrival time of an interrupt line which
+ * has been firing at a regular rate on this CPU, or U64_MAX when there
+ * is no such line.
+ */
+u64 irq_timings_next_event(u64 now)
+{
+	struct irq_timings *irqt = this_cpu_ptr(&irq_timings);
+	u64 next, next_evt = U64_MAX;
+	int i;
+
+	if (!static_branch_unlikely(&irq_timing_enabled))
+		return U64_MAX;
+
+	for (i = 0; i < IRQT_SLOTS; i++) {
+		struct irqt_stat *s = &irqt->stat[i];
+
+		if (s->count <= IRQT_MIN_SAMPLES || !s->avg)
+			continue;
+
+		/* Irregular: the deviation is above a quarter of the period */
+		if (s->dev > s->avg >> 2)
+			continue;
+
+		/* More than one arrival missed, the source has likely stopped */
+		if (now - s->last_ts > 2 * s->avg)
+			continue;
+
+		next = s->last_ts + s->avg;
+		if (next <= now)
+			next += s->avg;
+
+		if (next < next_evt)
+			next_evt = next;
+	}
+
+	return next_evt;
+}
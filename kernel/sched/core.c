@@ -6175,6 +6175,10 @@ static void update_top_cache_domain(int cpu)
 	per_cpu(sd_llc_id, cpu) = id;
 	rcu_assign_pointer(per_cpu(sd_llc_shared, cpu), sds);
 
+	/* Start out as idle; the first wakeup scan corrects a busy CPU */
+	if (sds)
+		cpumask_set_cpu(cpu, sds_idle_cpus(sds));
+
 	sd = lowest_flag_domain(cpu, SD_NUMA);
 	rcu_assign_pointer(per_cpu(sd_numa, cpu), sd);
 
@@ -7145,7 +7149,8 @@ static int __sdt_alloc(const struct cpumask *cpu_map)
 
 			*per_cpu_ptr(sdd->sd, j) = sd;
 
-			sds = kzalloc_node(sizeof(struct sched_domain_shared),
+			sds = kzalloc_node(sizeof(struct sched_domain_shared) +
+					cpumask_size(),
 					GFP_KERNEL, cpu_to_node(j));
 			if (!sds)
 				return -ENOMEM;
@@ -8110,6 +8115,9 @@ static DEFINE_SPINLOCK(task_group_lock);
 
 static void sched_free_group(struct task_group *tg)
 {
+#ifdef CONFIG_SCHEDSTATS
+	free_percpu(tg->lat_hist);
+#endif
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
@@ -8131,6 +8139,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHEDSTATS
+	tg->lat_hist = alloc_percpu(struct sched_lat_hist);
+	if (!tg->lat_hist)
+		goto err;
+#endif
+
 	return tg;
 
 err:
@@ -9009,6 +9023,41 @@ static u64 cpu_rt_period_read_uint(struct cgroup_subsys_state *css,
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Runqueue latency histograms of the group's tasks summed over all cpus,
+ * in the format of /proc/schedlat. The root group reports all tasks.
+ */
+static int cpu_latency_hist_show(struct seq_file *sf, void *v)
+{
+	struct task_group *tg = css_tg(seq_css(sf));
+	struct sched_lat_hist *sum, *hist;
+	int cpu, i;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		if (tg->lat_hist)
+			hist = per_cpu_ptr(tg->lat_hist, cpu);
+		else
+			hist = &cpu_rq(cpu)->rq_lat_hist;
+
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++) {
+			sum->wakeup[i] += hist->wakeup[i];
+			sum->preempt[i] += hist->preempt[i];
+		}
+	}
+
+	sched_lat_hist_show_bounds(sf);
+	sched_lat_hist_show(sf, "", sum);
+	kfree(sum);
+
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -9044,6 +9093,12 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_rt_period_read_uint,
 		.write_u64 = cpu_rt_period_write_uint,
 	},
+#endif
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "latency_hist",
+		.seq_show = cpu_latency_hist_show,
+	},
 #endif
 	{ }	/* terminate */
 };
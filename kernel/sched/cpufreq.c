@@ -10,6 +10,7 @@
  */
 
 #include "sched.h"
+#include "tune.h"
 
 DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
 
@@ -61,3 +62,44 @@ void cpufreq_remove_update_util_hook(int cpu)
 	rcu_assign_pointer(per_cpu(cpufreq_update_util_data, cpu), NULL);
 }
 EXPORT_SYMBOL_GPL(cpufreq_remove_update_util_hook);
+
+#ifdef CONFIG_SMP
+unsigned long boosted_cpu_util(int cpu);
+
+/**
+ * cpufreq_get_util - Get the utilization of the current CPU.
+ * @time: Current time, as passed to the update_util hook.
+ * @max: Returns the capacity of the CPU at its highest frequency.
+ *
+ * Let governors outside of the scheduler select frequencies from the same
+ * signal schedutil uses: the boosted CFS utilization plus, unless WALT
+ * already accounts for them, the RT tasks' average.
+ *
+ * Must be called from an update_util hook.
+ */
+unsigned long cpufreq_get_util(u64 time, unsigned long *max)
+{
+	int cpu = smp_processor_id();
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long util, rt;
+	s64 delta;
+
+	*max = arch_scale_cpu_capacity(NULL, cpu);
+	util = boosted_cpu_util(cpu);
+
+#ifdef CONFIG_SCHED_WALT
+	if (!walt_disabled && sysctl_sched_use_walt_cpu_util)
+		return min(util, *max);
+#endif
+
+	sched_avg_update(rq);
+	delta = time - rq->age_stamp;
+	if (unlikely(delta < 0))
+		delta = 0;
+	rt = div64_u64(rq->rt_avg, sched_avg_period() + delta);
+	rt = (rt * *max) >> SCHED_CAPACITY_SHIFT;
+
+	return min(schedtune_cpu_clamp_util(cpu, util + rt), *max);
+}
+EXPORT_SYMBOL_GPL(cpufreq_get_util);
+#endif
@@ -21,11 +21,6 @@
 
 unsigned long boosted_cpu_util(int cpu);
 
-/* Stub out fast switch routines present on mainline to reduce the backport
- * overhead. */
-#define cpufreq_driver_fast_switch(x, y) 0
-#define cpufreq_enable_fast_switch(x)
-#define cpufreq_disable_fast_switch(x)
 #define LATENCY_MULTIPLIER			(1000)
 #define SUGOV_KTHREAD_PRIORITY	50
 
@@ -257,6 +252,8 @@ static void sugov_get_util(unsigned long *util, unsigned long *max, u64 time)
 		*util = min((*util + rt), max_cap);
 	}
 
+	/* Caps and floors apply to what is requested, rt included */
+	*util = min(schedtune_cpu_clamp_util(cpu, *util), max_cap);
 	*max = max_cap;
 }
 
@@ -17,6 +17,7 @@
 #include <linux/utsname.h>
 #include <linux/mempolicy.h>
 #include <linux/debugfs.h>
+#include <linux/sched_energy.h>
 
 #include "sched.h"
 
@@ -260,6 +261,23 @@ set_table_entry(struct ctl_table *entry,
 	}
 }
 
+/*
+ * Capacity states may be tuned at runtime; keep the energy lookup tables,
+ * which cache them, in sync.
+ */
+static int proc_sched_cap_states(struct ctl_table *table, int write,
+				 void __user *buffer, size_t *lenp,
+				 loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
+	if (!ret && write)
+		sched_energy_update_luts();
+
+	return ret;
+}
+
 static struct ctl_table *
 sd_alloc_ctl_energy_table(struct sched_group_energy *sge)
 {
@@ -277,7 +295,7 @@ sd_alloc_ctl_energy_table(struct sched_group_energy *sge)
 			sizeof(int), 0644, proc_dointvec_minmax, false);
 	set_table_entry(&table[3], "cap_states", &sge->cap_states[0].cap,
 			sge->nr_cap_states*sizeof(struct capacity_state), 0644,
-			proc_doulongvec_minmax, false);
+			proc_sched_cap_states, false);
 
 	return table;
 }
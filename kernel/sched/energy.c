@@ -31,13 +31,19 @@ struct sched_group_energy *sge_array[NR_CPUS][NR_SD_LEVELS];
 
 static void free_resources(void)
 {
-	int cpu, sd_level;
+	int cpu, sd_level, i;
 	struct sched_group_energy *sge;
 
 	for_each_possible_cpu(cpu) {
 		for_each_possible_sd_level(sd_level) {
 			sge = sge_array[cpu][sd_level];
 			if (sge) {
+				/* Drop other CPUs' references to shared data */
+				for_each_possible_cpu(i) {
+					if (sge_array[i][sd_level] == sge)
+						sge_array[i][sd_level] = NULL;
+				}
+				kfree(sge->lut);
 				kfree(sge->cap_states);
 				kfree(sge->idle_states);
 				kfree(sge);
@@ -46,6 +52,129 @@ static void free_resources(void)
 	}
 }
 
+static bool same_cap_states(const struct sched_group_energy *a,
+			    const struct sched_group_energy *b)
+{
+	int i;
+
+	if (a->nr_cap_states != b->nr_cap_states)
+		return false;
+
+	for (i = 0; i < a->nr_cap_states; i++) {
+		if (a->cap_states[i].cap != b->cap_states[i].cap)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Refresh the utilization lookup table of @sge. Each entry holds the
+ * lowest capacity state able to serve the bottom of its bucket, along
+ * with the busy power of @sge and of the level below it in that state,
+ * so that the wakeup path gets all of them from a single entry.
+ */
+static void update_lut(struct sched_group_energy *sge)
+{
+	struct sched_energy_lut *lut = sge->lut;
+	const struct sched_group_energy *core = lut->core;
+	unsigned long util;
+	int b, idx = 0;
+
+	lut->core_valid = core && same_cap_states(sge, core);
+
+	for (b = 0; b < SGE_CAP_LUT_SIZE; b++) {
+		util = (unsigned long)b << SGE_CAP_LUT_SHIFT;
+		while (idx < sge->nr_cap_states - 1 &&
+		       sge->cap_states[idx].cap < util)
+			idx++;
+
+		lut->ent[b].idx = idx;
+		lut->ent[b].cap = sge->cap_states[idx].cap;
+		lut->ent[b].power = sge->cap_states[idx].power;
+		lut->ent[b].core_power = lut->core_valid ?
+					 core->cap_states[idx].power : 0;
+	}
+}
+
+/*
+ * Refresh the lookup tables of all levels. Must be called whenever
+ * cap_states changes, as a cluster's table also caches its cores' power.
+ */
+void sched_energy_update_luts(void)
+{
+	struct sched_group_energy *sge;
+	int cpu, sd_level;
+
+	for_each_possible_cpu(cpu) {
+		for_each_possible_sd_level(sd_level) {
+			sge = sge_array[cpu][sd_level];
+			if (sge && sge->lut)
+				update_lut(sge);
+		}
+	}
+}
+
+static void init_lut(struct sched_group_energy *sge)
+{
+	/* States are indexed by u8; fall back to a linear scan otherwise */
+	if (sge->nr_cap_states > U8_MAX + 1)
+		return;
+
+	sge->lut = kzalloc(sizeof(*sge->lut), GFP_NOWAIT);
+}
+
+/* Point each level's table at the energy data of the level below */
+static void link_luts(void)
+{
+	struct sched_group_energy *sge;
+	int cpu, sd_level;
+
+	for_each_possible_cpu(cpu) {
+		for (sd_level = SD_LEVEL1; sd_level < NR_SD_LEVELS; sd_level++) {
+			sge = sge_array[cpu][sd_level];
+			if (sge && sge->lut)
+				sge->lut->core = sge_array[cpu][sd_level - 1];
+		}
+	}
+
+	sched_energy_update_luts();
+}
+
+/*
+ * CPUs of a cluster usually point at the same sched-energy-costs node.
+ * Return the data already parsed for an earlier CPU if so, to keep a
+ * single, cache-friendly copy per cluster.
+ */
+static struct sched_group_energy *
+find_shared_sge(int cpu, int sd_level, struct device_node *cp)
+{
+	struct device_node *cn, *np;
+	struct sched_group_energy *sge = NULL;
+	int i;
+
+	for_each_possible_cpu(i) {
+		if (i >= cpu)
+			break;
+		if (!sge_array[i][sd_level])
+			continue;
+
+		cn = of_get_cpu_node(i, NULL);
+		if (!cn)
+			continue;
+		np = of_parse_phandle(cn, "sched-energy-costs", sd_level);
+		of_node_put(cn);
+		of_node_put(np);
+
+		if (np == cp) {
+			sge = sge_array[i][sd_level];
+			break;
+		}
+	}
+
+	return sge;
+}
+
 void init_sched_energy_costs(void)
 {
 	struct device_node *cn, *cp;
@@ -73,6 +202,13 @@ void init_sched_energy_costs(void)
 			if (!cp)
 				break;
 
+			sge = find_shared_sge(cpu, sd_level, cp);
+			if (sge) {
+				sge_array[cpu][sd_level] = sge;
+				of_node_put(cp);
+				continue;
+			}
+
 			prop = of_find_property(cp, "busy-cost-data", NULL);
 			if (!prop || !prop->value) {
 				pr_warn("No busy-cost data, skipping sched_energy init\n");
@@ -94,6 +230,7 @@ void init_sched_energy_costs(void)
 
 			sge->nr_cap_states = nstates;
 			sge->cap_states = cap_states;
+			init_lut(sge);
 
 			prop = of_find_property(cp, "idle-cost-data", NULL);
 			if (!prop || !prop->value) {
@@ -116,6 +253,8 @@ void init_sched_energy_costs(void)
 		}
 	}
 
+	link_luts();
+
 	pr_info("Sched-energy-costs installed from DT\n");
 	return;
 
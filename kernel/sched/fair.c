@@ -5817,26 +5817,83 @@ long group_norm_util(struct energy_env *eenv, int cpu_idx)
 	return min_t(unsigned long, util_sum, SCHED_CAPACITY_SCALE);
 }
 
+/*
+ * Find the lowest capacity state able to serve @util, starting from the
+ * hint in the group's lookup table rather than from the lowest state.
+ * Capacity states are sorted, so walking a step or two either way from the
+ * hint gives the exact answer even if cap_states was tuned since the table
+ * was last refreshed.
+ */
+static int __find_new_capacity(const struct sched_group_energy *sge,
+			       unsigned long util)
+{
+	int idx, max_idx = sge->nr_cap_states - 1;
+
+	if (!sge->lut) {
+		for (idx = 0; idx < max_idx; idx++) {
+			if (sge->cap_states[idx].cap >= util)
+				break;
+		}
+		return idx;
+	}
+
+	idx = sge->lut->ent[min_t(unsigned long,
+				  util >> SGE_CAP_LUT_SHIFT,
+				  SGE_CAP_LUT_SIZE - 1)].idx;
+	while (idx > 0 && sge->cap_states[idx - 1].cap >= util)
+		idx--;
+	while (idx < max_idx && sge->cap_states[idx].cap < util)
+		idx++;
+
+	return idx;
+}
+
 static int find_new_capacity(struct energy_env *eenv, int cpu_idx)
 {
 	const struct sched_group_energy *sge = eenv->sg->sge;
-	int idx, max_idx = sge->nr_cap_states - 1;
 	unsigned long util = group_max_util(eenv, cpu_idx);
+	int idx = __find_new_capacity(sge, util);
 
-	/* default is max_cap if we don't find a match */
-	eenv->cpu[cpu_idx].cap_idx = max_idx;
-	eenv->cpu[cpu_idx].cap = sge->cap_states[max_idx].cap;
+	/* Keep track of SG's capacity; max_cap if we don't find a match */
+	eenv->cpu[cpu_idx].cap_idx = idx;
+	eenv->cpu[cpu_idx].cap = sge->cap_states[idx].cap;
 
-	for (idx = 0; idx < sge->nr_cap_states; idx++) {
-		if (sge->cap_states[idx].cap >= util) {
-			/* Keep track of SG's capacity */
-			eenv->cpu[cpu_idx].cap_idx = idx;
-			eenv->cpu[cpu_idx].cap = sge->cap_states[idx].cap;
-			break;
+	return idx;
+}
+
+/*
+ * Estimate the idle state @sg can reach once a task moves into or out of
+ * it, leaving @grp_util spread over its CPUs.
+ */
+static int group_idle_state_estimate(struct sched_group *sg, long grp_util)
+{
+	if (grp_util <=
+		((long)sg->sgc->max_capacity * (int)sg->group_weight)) {
+		/* after moving, this group is at most partly
+		 * occupied, so it should have some idle time.
+		 */
+		int max_idle_state_idx = sg->sge->nr_idle_states - 2;
+		int new_state = grp_util * max_idle_state_idx;
+		if (grp_util <= 0)
+			/* group will have no util, use lowest state */
+			new_state = max_idle_state_idx + 1;
+		else {
+			/* for partially idle, linearly map util to idle
+			 * states, excluding the lowest one. This does not
+			 * correspond to the state we expect to enter in
+			 * reality, but an indication of what might happen.
+			 */
+			new_state = min(max_idle_state_idx, (int)
+					(new_state / sg->sgc->max_capacity));
+			new_state = max_idle_state_idx - new_state;
 		}
+		return new_state;
 	}
 
-	return eenv->cpu[cpu_idx].cap_idx;
+	/* After moving, the group will be fully occupied
+	 * so assume it will not be idle at all.
+	 */
+	return 0;
 }
 
 static int group_idle_state(struct energy_env *eenv, int cpu_idx)
@@ -5874,33 +5931,7 @@ static int group_idle_state(struct energy_env *eenv, int cpu_idx)
 			grp_util += eenv->util_delta;
 	}
 
-	if (grp_util <=
-		((long)sg->sgc->max_capacity * (int)sg->group_weight)) {
-		/* after moving, this group is at most partly
-		 * occupied, so it should have some idle time.
-		 */
-		int max_idle_state_idx = sg->sge->nr_idle_states - 2;
-		int new_state = grp_util * max_idle_state_idx;
-		if (grp_util <= 0)
-			/* group will have no util, use lowest state */
-			new_state = max_idle_state_idx + 1;
-		else {
-			/* for partially idle, linearly map util to idle
-			 * states, excluding the lowest one. This does not
-			 * correspond to the state we expect to enter in
-			 * reality, but an indication of what might happen.
-			 */
-			new_state = min(max_idle_state_idx, (int)
-					(new_state / sg->sgc->max_capacity));
-			new_state = max_idle_state_idx - new_state;
-		}
-		state = new_state;
-	} else {
-		/* After moving, the group will be fully occupied
-		 * so assume it will not be idle at all.
-		 */
-		state = 0;
-	}
+	state = group_idle_state_estimate(sg, grp_util);
 end:
 	return state;
 }
@@ -6059,6 +6090,166 @@ static int compute_energy(struct energy_env *eenv)
 	return 0;
 }
 
+/* Largest cluster handled by compute_cluster_energy() */
+#define EAS_CLUSTER_MAX_CPUS	8
+
+/*
+ * eas_cluster_domain() returns the domain of the cores of @sg_top if it is
+ * a plain cluster: one group per core below it, all sharing the capacity
+ * states of the cluster, and a lookup table covering both levels.
+ * compute_energy() walks such a cluster as its core groups followed by
+ * the cluster group, with the cluster as the frequency domain.
+ */
+static struct sched_domain *eas_cluster_domain(struct sched_group *sg_top)
+{
+	const struct sched_energy_lut *lut = sg_top->sge->lut;
+	struct sched_domain *sd;
+
+	if (!lut || !lut->core_valid ||
+	    sg_top->group_weight > EAS_CLUSTER_MAX_CPUS)
+		return NULL;
+
+	sd = rcu_dereference(cpu_rq(group_first_cpu(sg_top))->sd);
+	if (!sd || !sd->parent ||
+	    !(sd->flags & SD_SHARE_CAP_STATES) ||
+	    (sd->parent->flags & SD_SHARE_CAP_STATES) ||
+	    !cpumask_equal(sched_domain_span(sd), sched_group_cpus(sg_top)))
+		return NULL;
+
+	return sd;
+}
+
+/*
+ * compute_cluster_energy() gives the energy compute_energy() computes for
+ * a plain cluster, without walking its groups once per candidate: the
+ * utilization and idle state of each core are sampled once, and for each
+ * candidate the capacity state and busy power of both the cluster and
+ * its cores come from a single lookup table entry.
+ *
+ * Returns false if eenv->sg_top is not a plain cluster, in which case
+ * compute_energy() has to be used.
+ */
+static bool compute_cluster_energy(struct energy_env *eenv)
+{
+	struct sched_group *sg_top = eenv->sg_top;
+	const struct sched_group_energy *sge = sg_top->sge;
+	const struct sched_group_energy *core_sge;
+	struct sched_group *core_sg[EAS_CLUSTER_MAX_CPUS], *sg;
+	unsigned long util[EAS_CLUSTER_MAX_CPUS];
+	int cpus[EAS_CLUSTER_MAX_CPUS], idle[EAS_CLUSTER_MAX_CPUS];
+	int prev_cpu = eenv->cpu[EAS_CPU_PRV].cpu_id;
+	unsigned long min_util = 0;
+	long util_sum = 0;
+	int sg_idle = INT_MAX;
+	struct sched_domain *sd;
+	int cpu_idx, i, nr = 0;
+	bool src_in_grp;
+
+	sd = eas_cluster_domain(sg_top);
+	if (!sd)
+		return false;
+
+	core_sge = sge->lut->core;
+	sg = sd->groups;
+	do {
+		if (nr == EAS_CLUSTER_MAX_CPUS || sg->group_weight != 1 ||
+		    sg->sge != core_sge)
+			return false;
+
+		core_sg[nr] = sg;
+		cpus[nr] = group_first_cpu(sg);
+		util[nr] = cpu_util_wake(cpus[nr], eenv->p);
+		util_sum += util[nr];
+		/* See group_max_util() */
+		min_util = max(min_util, capacity_min_of(cpus[nr]));
+
+		/* See group_idle_state() */
+		idle[nr] = idle_get_state_idx(cpu_rq(cpus[nr]));
+		sg_idle = min(sg_idle, idle[nr]);
+		idle[nr]++;
+		nr++;
+	} while (sg = sg->next, sg != sd->groups);
+	sg_idle++;
+
+	src_in_grp = cpumask_test_cpu(prev_cpu, sched_group_cpus(sg_top));
+
+	for (cpu_idx = EAS_CPU_PRV; cpu_idx < EAS_CPU_CNT; ++cpu_idx) {
+		int dst_cpu = eenv->cpu[cpu_idx].cpu_id;
+		unsigned long max_util = min_util, cpu_util, sg_util = 0;
+		unsigned int busy_power, core_busy_power;
+		unsigned long cap, norm_util;
+		bool dst_in_grp = false;
+		int cap_idx, idle_idx;
+		int total_energy = 0;
+
+		if (dst_cpu == -1)
+			continue;
+
+		for (i = 0; i < nr; i++) {
+			cpu_util = util[i];
+			if (cpus[i] == dst_cpu) {
+				cpu_util += eenv->util_delta;
+				dst_in_grp = true;
+			}
+			max_util = max(max_util, cpu_util);
+		}
+
+		/* See find_new_capacity() */
+		i = min_t(unsigned long, max_util >> SGE_CAP_LUT_SHIFT,
+			  SGE_CAP_LUT_SIZE - 1);
+		cap_idx = sge->lut->ent[i].idx;
+		if (sge->lut->ent[i].cap >= max_util ||
+		    cap_idx == sge->nr_cap_states - 1) {
+			cap = sge->lut->ent[i].cap;
+			busy_power = sge->lut->ent[i].power;
+			core_busy_power = sge->lut->ent[i].core_power;
+		} else {
+			/* A state further up within the bucket */
+			cap_idx = __find_new_capacity(sge, max_util);
+			cap = sge->cap_states[cap_idx].cap;
+			busy_power = sge->cap_states[cap_idx].power;
+			core_busy_power = core_sge->cap_states[cap_idx].power;
+		}
+		eenv->cpu[cpu_idx].cap_idx = cap_idx;
+		eenv->cpu[cpu_idx].cap = cap;
+
+		/* The cores, as calc_sg_energy() does for each core group */
+		for (i = 0; i < nr; i++) {
+			cpu_util = util[i];
+			if (cpus[i] == dst_cpu)
+				cpu_util += eenv->util_delta;
+
+			norm_util = __cpu_norm_util(cpu_util, cap);
+			sg_util += norm_util;
+
+			idle_idx = idle[i];
+			if ((cpus[i] == prev_cpu) != (cpus[i] == dst_cpu))
+				idle_idx = group_idle_state_estimate(core_sg[i],
+								     cpu_util);
+
+			total_energy += norm_util * core_busy_power;
+			total_energy += (SCHED_CAPACITY_SCALE - norm_util) *
+					core_sge->idle_states[idle_idx].power;
+		}
+
+		/* The cluster */
+		sg_util = min_t(unsigned long, sg_util, SCHED_CAPACITY_SCALE);
+
+		idle_idx = sg_idle;
+		if (src_in_grp != dst_in_grp)
+			idle_idx = group_idle_state_estimate(sg_top, util_sum +
+					(dst_in_grp ? eenv->util_delta : 0));
+
+		total_energy += sg_util * busy_power;
+		total_energy += (SCHED_CAPACITY_SCALE - sg_util) *
+				sge->idle_states[idle_idx].power;
+
+		eenv->cpu[cpu_idx].energy += total_energy;
+	}
+
+	return true;
+}
+
 static inline bool cpu_in_sg(struct sched_group *sg, int cpu)
 {
 	return cpu != -1 && cpumask_test_cpu(cpu, sched_group_cpus(sg));
@@ -6109,6 +6300,8 @@ static inline int select_energy_cpu_idx(struct energy_env *eenv)
 
 		eenv->sg_top = sg;
 		/* energy is unscaled to reduce rounding errors */
+		if (compute_cluster_energy(eenv))
+			continue;
 		if (compute_energy(eenv) == -EINVAL)
 			return EAS_CPU_PRV;
 
@@ -6260,6 +6453,9 @@ static inline unsigned long task_util(struct task_struct *p)
 #ifdef CONFIG_SCHED_WALT
 	if (!walt_disabled && sysctl_sched_use_walt_task_util) {
 		unsigned long demand = p->ravg.demand;
+
+		if (sysctl_sched_walt_pred_demand)
+			demand = max(demand, (unsigned long)p->ravg.pred_demand);
 		return (demand << SCHED_CAPACITY_SHIFT) / walt_ravg_window;
 	}
 #endif
@@ -6383,7 +6579,7 @@ boosted_cpu_util(int cpu)
 
 	trace_sched_boost_cpu(cpu, util, margin);
 
-	return util + margin;
+	return schedtune_cpu_clamp_util(cpu, util + margin);
 }
 
 static inline unsigned long
@@ -6394,7 +6590,7 @@ boosted_task_util(struct task_struct *p)
 
 	trace_sched_boost_task(p, util, margin);
 
-	return util + margin;
+	return schedtune_task_clamp_util(p, util + margin);
 }
 
 static unsigned long capacity_spare_wake(int cpu, struct task_struct *p)
@@ -6762,6 +6958,29 @@ static inline int select_idle_smt(struct task_struct *p, struct sched_domain *sd
 
 #endif /* CONFIG_SCHED_SMT */
 
+/*
+ * Track idle CPUs of the LLC in sd_llc_shared's idle cpumask, so that
+ * select_idle_cpu() only needs to look at CPUs that went idle rather than
+ * at the whole domain span. Called on idle entry and exit.
+ */
+void update_idle_cpumask(struct rq *rq, bool idle)
+{
+	struct sched_domain_shared *sds;
+	int cpu = cpu_of(rq);
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (sds) {
+		if (idle) {
+			/* Pairs with the recheck in select_idle_cpu() */
+			smp_mb__before_atomic();
+			cpumask_set_cpu(cpu, sds_idle_cpus(sds));
+		} else
+			cpumask_clear_cpu(cpu, sds_idle_cpus(sds));
+	}
+	rcu_read_unlock();
+}
+
 /*
  * Scan the LLC domain for idle CPUs; this is dynamically regulated by
  * comparing the average scan cost (tracked in sd->avg_scan_cost) against the
@@ -6769,11 +6988,12 @@ static inline int select_idle_smt(struct task_struct *p, struct sched_domain *sd
  */
 static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int target)
 {
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
 	struct sched_domain *this_sd;
 	u64 avg_cost, avg_idle = this_rq()->avg_idle;
 	u64 time, cost;
 	s64 delta;
-	int cpu;
+	int cpu, nr = 0;
 
 	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
 	if (!this_sd)
@@ -6790,13 +7010,41 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 
 	time = local_clock();
 
-	for_each_cpu_wrap(cpu, sched_domain_span(sd), target) {
-		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
-			continue;
+	if (sched_feat(SIS_IDLE_MASK) && sd->shared)
+		cpumask_and(cpus, sds_idle_cpus(sd->shared),
+			    tsk_cpus_allowed(p));
+	else
+		cpumask_and(cpus, sched_domain_span(sd), tsk_cpus_allowed(p));
+
+	for_each_cpu_wrap(cpu, cpus, target) {
+		nr++;
 		if (idle_cpu(cpu))
 			break;
+
+		/*
+		 * Stale hint: the CPU has tasks queued. Drop it; it is set
+		 * again on its next idle entry. Don't go by rq->curr here:
+		 * the bit is set in pick_next_task_idle(), before __schedule()
+		 * switches rq->curr to the idle task.
+		 */
+		if (sched_feat(SIS_IDLE_MASK) && sd->shared &&
+		    cpu_rq(cpu)->nr_running) {
+			cpumask_clear_cpu(cpu, sds_idle_cpus(sd->shared));
+
+			/*
+			 * The CPU may have gone idle and set its bit since
+			 * nr_running was read. Put the bit back rather than
+			 * hide the CPU for its whole idle period.
+			 */
+			smp_mb__after_atomic();
+			if (!READ_ONCE(cpu_rq(cpu)->nr_running))
+				cpumask_set_cpu(cpu, sds_idle_cpus(sd->shared));
+		}
 	}
 
+	schedstat_add(this_rq()->eas_stats.sis_scanned, nr);
+	schedstat_add(sd->eas_stats.sis_scanned, nr);
+
 	time = local_clock() - time;
 	cost = this_sd->avg_scan_cost;
 	delta = (s64)(time - cost) / 8;
@@ -7383,10 +7631,13 @@ static int wake_cap(struct task_struct *p, int cpu, int prev_cpu)
 static int select_energy_cpu_brute(struct task_struct *p, int prev_cpu, int sync)
 {
 	bool boosted, prefer_idle;
+	bool timed = schedstat_enabled();
 	struct sched_domain *sd;
+	u64 start = 0;
 	int target_cpu;
 	int backup_cpu;
 	int next_cpu;
+	int next_idx;
 
 	schedstat_inc(p->se.statistics.nr_wakeups_secb_attempts);
 	schedstat_inc(this_rq()->eas_stats.secb_attempts);
@@ -7420,7 +7671,12 @@ static int select_energy_cpu_brute(struct task_struct *p, int prev_cpu, int sync
 	sync_entity_load_avg(&p->se);
 
 	/* Find a cpu with sufficient capacity */
+	if (timed)
+		start = sched_clock_cpu(smp_processor_id());
 	next_cpu = find_best_target(p, &backup_cpu, boosted, prefer_idle);
+	if (timed)
+		schedstat_add(this_rq()->eas_stats.fbt_time,
+			      sched_clock_cpu(smp_processor_id()) - start);
 	if (next_cpu == -1) {
 		target_cpu = prev_cpu;
 		goto unlock;
@@ -7469,7 +7725,13 @@ static int select_energy_cpu_brute(struct task_struct *p, int prev_cpu, int sync
 		}
 
 		/* Check if EAS_CPU_NXT is a more energy efficient CPU */
-		if (select_energy_cpu_idx(&eenv) != EAS_CPU_PRV) {
+		if (timed)
+			start = sched_clock_cpu(smp_processor_id());
+		next_idx = select_energy_cpu_idx(&eenv);
+		if (timed)
+			schedstat_add(this_rq()->eas_stats.secb_nrg_time,
+				      sched_clock_cpu(smp_processor_id()) - start);
+		if (next_idx != EAS_CPU_PRV) {
 			schedstat_inc(p->se.statistics.nr_wakeups_secb_nrg_sav);
 			schedstat_inc(this_rq()->eas_stats.secb_nrg_sav);
 			target_cpu = eenv.cpu[eenv.next_idx].cpu_id;
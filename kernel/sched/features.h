@@ -56,6 +56,12 @@ SCHED_FEAT(TTWU_QUEUE, true)
  */
 SCHED_FEAT(SIS_AVG_CPU, false)
 
+/*
+ * Scan only the CPUs the LLC's idle cpumask reports as idle when looking
+ * for an idle CPU on wakeup, rather than the whole domain span.
+ */
+SCHED_FEAT(SIS_IDLE_MASK, true)
+
 #ifdef HAVE_RT_PUSH_IPI
 /*
  * In order to avoid a thundering herd attack of CPUs that are
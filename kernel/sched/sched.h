@@ -51,6 +51,12 @@ extern void update_idle_core(struct rq *rq);
 static inline void update_idle_core(struct rq *rq) { }
 #endif
 
+#ifdef CONFIG_SMP
+extern void update_idle_cpumask(struct rq *rq, bool idle);
+#else
+static inline void update_idle_cpumask(struct rq *rq, bool idle) { }
+#endif
+
 /*
  * Helpers for converting nanosecond timing to jiffy resolution
  */
@@ -232,6 +238,27 @@ bool __dl_overflow(struct dl_bw *dl_b, int cpus, u64 old_bw, u64 new_bw)
 
 extern struct mutex sched_domains_mutex;
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Runqueue latency histograms. Bucket i counts delays shorter than
+ * 1024ns << i (and at least half that for i > 0); the last bucket also
+ * takes everything longer.
+ */
+#define SCHED_LAT_BUCKETS	24
+
+struct sched_lat_hist {
+	/* queued on wakeup until running */
+	u64 wakeup[SCHED_LAT_BUCKETS];
+	/* queued on preemption until running again */
+	u64 preempt[SCHED_LAT_BUCKETS];
+};
+
+struct seq_file;
+extern void sched_lat_hist_show(struct seq_file *seq, const char *prefix,
+				const struct sched_lat_hist *hist);
+extern void sched_lat_hist_show_bounds(struct seq_file *seq);
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 
 #include <linux/cgroup.h>
@@ -301,6 +328,11 @@ struct task_group {
 #endif
 
 	struct cfs_bandwidth cfs_bandwidth;
+
+#ifdef CONFIG_SCHEDSTATS
+	/* per cpu latency histograms, NULL for the root group */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -728,6 +760,7 @@ struct rq {
 
 #ifdef CONFIG_SCHED_WALT
 	u64 cumulative_runnable_avg;
+	u64 cumulative_pred_demand;
 	u64 window_start;
 	u64 curr_runnable_sum;
 	u64 prev_runnable_sum;
@@ -765,6 +798,7 @@ struct rq {
 #ifdef CONFIG_SCHEDSTATS
 	/* latency stats */
 	struct sched_info rq_sched_info;
+	struct sched_lat_hist rq_lat_hist;
 	unsigned long long rq_cpu_time;
 	/* could above be rq->cfs_rq.exec_clock + rq->rt_rq.rt_runtime ? */
 
@@ -1690,9 +1724,19 @@ static inline unsigned long cpu_util_freq(int cpu)
 	unsigned long capacity = capacity_orig_of(cpu);
 
 #ifdef CONFIG_SCHED_WALT
-	if (!walt_disabled && sysctl_sched_use_walt_cpu_util)
-		util = div64_u64(cpu_rq(cpu)->prev_runnable_sum,
+	if (!walt_disabled && sysctl_sched_use_walt_cpu_util) {
+		u64 busy = cpu_rq(cpu)->prev_runnable_sum;
+
+		/*
+		 * Tasks whose history says they are about to get busier pull
+		 * the frequency up ahead of the window that shows it.
+		 */
+		if (sysctl_sched_walt_pred_demand)
+			busy = max(busy, cpu_rq(cpu)->cumulative_pred_demand);
+
+		util = div64_u64(busy,
 				 walt_ravg_window >> SCHED_CAPACITY_SHIFT);
+	}
 #endif
 	return (util >= capacity) ? capacity : util;
 }
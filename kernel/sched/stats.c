@@ -10,7 +10,7 @@
  * bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 17
 
 #ifdef CONFIG_SMP
 static inline void show_easstat(struct seq_file *seq, struct eas_stats *stats)
@@ -29,11 +29,75 @@ static inline void show_easstat(struct seq_file *seq, struct eas_stats *stats)
 	    stats->fbt_attempts, stats->fbt_no_cpu, stats->fbt_no_sd,
 	    stats->fbt_pref_idle, stats->fbt_count);
 
-	seq_printf(seq, "%llu %llu\n",
+	seq_printf(seq, "%llu %llu ",
 	    stats->cas_attempts, stats->cas_count);
+
+	/* Newer fields go last so positional parsers keep working */
+	seq_printf(seq, "%llu %llu %llu\n",
+	    stats->secb_nrg_time, stats->fbt_time, stats->sis_scanned);
 }
 #endif
 
+static inline int sched_lat_bucket(unsigned long long delta)
+{
+	return min(fls64(delta >> 10), SCHED_LAT_BUCKETS - 1);
+}
+
+/*
+ * Record how long @t waited on @rq before running, split by whether it had
+ * been queued by a wakeup or by being preempted. Called with rq->lock held.
+ */
+void __rq_sched_lat_account(struct rq *rq, struct task_struct *t,
+			    unsigned long long delta, bool preempt)
+{
+	int idx = sched_lat_bucket(delta);
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg = task_group(t);
+	struct sched_lat_hist *hist;
+#endif
+
+	if (preempt)
+		rq->rq_lat_hist.preempt[idx]++;
+	else
+		rq->rq_lat_hist.wakeup[idx]++;
+
+#ifdef CONFIG_CGROUP_SCHED
+	if (!tg->lat_hist)
+		return;
+
+	hist = per_cpu_ptr(tg->lat_hist, cpu_of(rq));
+	if (preempt)
+		hist->preempt[idx]++;
+	else
+		hist->wakeup[idx]++;
+#endif
+}
+
+void sched_lat_hist_show(struct seq_file *seq, const char *prefix,
+			 const struct sched_lat_hist *hist)
+{
+	int i;
+
+	seq_printf(seq, "%swakeup", prefix);
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(seq, " %llu", hist->wakeup[i]);
+
+	seq_printf(seq, "\n%spreempt", prefix);
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(seq, " %llu", hist->preempt[i]);
+	seq_putc(seq, '\n');
+}
+
+void sched_lat_hist_show_bounds(struct seq_file *seq)
+{
+	int i;
+
+	seq_puts(seq, "bounds_ns");
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(seq, " %llu", 1024ULL << i);
+	seq_putc(seq, '\n');
+}
+
 static int show_schedstat(struct seq_file *seq, void *v)
 {
 	int cpu;
@@ -156,9 +220,52 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = seq_release,
 };
 
+/*
+ * /proc/schedlat: per cpu histograms of the time tasks spend runnable before
+ * getting the cpu, in power of two buckets. Updated while schedstats are
+ * enabled.
+ */
+#define SCHEDLAT_VERSION 1
+
+static int show_schedlat(struct seq_file *seq, void *v)
+{
+	char prefix[16];
+	int cpu;
+
+	if (v == (void *)1) {
+		seq_printf(seq, "version %d\n", SCHEDLAT_VERSION);
+		sched_lat_hist_show_bounds(seq);
+	} else {
+		cpu = (unsigned long)(v - 2);
+		snprintf(prefix, sizeof(prefix), "cpu%d ", cpu);
+		sched_lat_hist_show(seq, prefix, &cpu_rq(cpu)->rq_lat_hist);
+	}
+	return 0;
+}
+
+static const struct seq_operations schedlat_sops = {
+	.start = schedstat_start,
+	.next  = schedstat_next,
+	.stop  = schedstat_stop,
+	.show  = show_schedlat,
+};
+
+static int schedlat_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &schedlat_sops);
+}
+
+static const struct file_operations proc_schedlat_operations = {
+	.open    = schedlat_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = seq_release,
+};
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
+	proc_create("schedlat", 0, NULL, &proc_schedlat_operations);
 	return 0;
 }
 subsys_initcall(proc_schedstat_init);
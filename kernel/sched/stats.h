@@ -29,6 +29,21 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+extern struct static_key_false sched_schedstats;
+extern void __rq_sched_lat_account(struct rq *rq, struct task_struct *t,
+				   unsigned long long delta, bool preempt);
+
+/*
+ * Expects runqueue lock to be held for atomicity of update
+ */
+static inline void
+rq_sched_lat_account(struct rq *rq, struct task_struct *t,
+		     unsigned long long delta, bool preempt)
+{
+	if (static_branch_unlikely(&sched_schedstats))
+		__rq_sched_lat_account(rq, t, delta, preempt);
+}
 #define schedstat_enabled()		static_branch_unlikely(&sched_schedstats)
 #define schedstat_inc(var)		do { if (schedstat_enabled()) { var++; } } while (0)
 #define schedstat_add(var, amt)		do { if (schedstat_enabled()) { var += (amt); } } while (0)
@@ -46,6 +61,10 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void
+rq_sched_lat_account(struct rq *rq, struct task_struct *t,
+		     unsigned long long delta, bool preempt)
+{}
 #define schedstat_enabled()		0
 #define schedstat_inc(var)		do { } while (0)
 #define schedstat_add(var, amt)		do { } while (0)
@@ -87,12 +106,16 @@ static inline void sched_info_dequeued(struct rq *rq, struct task_struct *t)
 static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 {
 	unsigned long long now = rq_clock(rq), delta = 0;
+	bool preempt = t->sched_info.last_queued_preempt;
 
-	if (t->sched_info.last_queued)
+	if (t->sched_info.last_queued) {
 		delta = now - t->sched_info.last_queued;
+		rq_sched_lat_account(rq, t, delta, preempt);
+	}
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
+	t->sched_info.last_queued_preempt = 0;
 	t->sched_info.pcount++;
 
 	rq_sched_info_arrive(rq, delta);
@@ -125,8 +148,10 @@ static inline void sched_info_depart(struct rq *rq, struct task_struct *t)
 
 	rq_sched_info_depart(rq, delta);
 
-	if (t->state == TASK_RUNNING)
+	if (t->state == TASK_RUNNING) {
+		t->sched_info.last_queued_preempt = 1;
 		sched_info_queued(rq, t);
+	}
 }
 
 /*
@@ -188,6 +188,10 @@ struct schedtune {
 	/* Hint to bias scheduling of tasks on that SchedTune CGroup
 	 * towards idle CPUs */
 	int prefer_idle;
+
+	/* Utilization clamps for tasks on that SchedTune CGroup */
+	int util_min;
+	int util_max;
 };
 
 static inline struct schedtune *css_st(struct cgroup_subsys_state *css)
@@ -220,6 +224,8 @@ root_schedtune = {
 	.perf_boost_idx = 0,
 	.perf_constrain_idx = 0,
 	.prefer_idle = 0,
+	.util_min = 0,
+	.util_max = SCHED_CAPACITY_SCALE,
 };
 
 int
@@ -283,11 +289,17 @@ static struct schedtune *allocated_group[BOOSTGROUPS_COUNT] = {
 struct boost_groups {
 	/* Maximum boost value for all RUNNABLE tasks on a CPU */
 	int boost_max;
+	/* Maximum util_min/util_max clamps for all RUNNABLE tasks on a CPU */
+	int util_min_max;
+	int util_max_max;
 	struct {
 		/* True when this boost group maps an actual cgroup */
 		bool valid;
 		/* The boost for tasks on that boost group */
 		int boost;
+		/* The utilization clamps for tasks on that boost group */
+		int util_min;
+		int util_max;
 		/* Count of RUNNABLE tasks on that boost group */
 		unsigned tasks;
 	} group[BOOSTGROUPS_COUNT];
@@ -298,6 +310,36 @@ struct boost_groups {
 /* Boost groups affecting each CPU in the system */
 DEFINE_PER_CPU(struct boost_groups, cpu_boost_groups);
 
+/*
+ * Utilization clamps are max-aggregated across the boost groups with
+ * RUNNABLE tasks on a CPU: the CPU gets the highest floor any of them
+ * asks for, and is capped only as much as its least restricted group
+ * allows. Unlike boost, the root group counts only while it has RUNNABLE
+ * tasks, so an idle or background-only CPU is not lifted out of its caps.
+ */
+static void
+schedtune_cpu_update_clamps(struct boost_groups *bg)
+{
+	int util_min_max = 0;
+	int util_max_max = -1;
+	int idx;
+
+	for (idx = 0; idx < BOOSTGROUPS_COUNT; ++idx) {
+		if (!bg->group[idx].valid || !bg->group[idx].tasks)
+			continue;
+
+		util_min_max = max(util_min_max, bg->group[idx].util_min);
+		util_max_max = max(util_max_max, bg->group[idx].util_max);
+	}
+
+	/* No RUNNABLE tasks: nothing to clamp */
+	if (util_max_max < 0)
+		util_max_max = SCHED_CAPACITY_SCALE;
+
+	bg->util_min_max = util_min_max;
+	bg->util_max_max = util_max_max;
+}
+
 static void
 schedtune_cpu_update(int cpu)
 {
@@ -330,6 +372,8 @@ schedtune_cpu_update(int cpu)
 	 * task stacking and frequency spikes.*/
 	boost_max = max(boost_max, 0);
 	bg->boost_max = boost_max;
+
+	schedtune_cpu_update_clamps(bg);
 }
 
 static int
@@ -378,6 +422,31 @@ schedtune_boostgroup_update(int idx, int boost)
 	return 0;
 }
 
+static void
+schedtune_clampgroup_update(int idx, int util_min, int util_max)
+{
+	struct boost_groups *bg;
+	unsigned long irq_flags;
+	int cpu;
+
+	/* Update per CPU boost groups */
+	for_each_possible_cpu(cpu) {
+		bg = &per_cpu(cpu_boost_groups, cpu);
+
+		/* CGroups are never associated to non active cgroups */
+		BUG_ON(!bg->group[idx].valid);
+
+		raw_spin_lock_irqsave(&bg->lock, irq_flags);
+		bg->group[idx].util_min = util_min;
+		bg->group[idx].util_max = util_max;
+
+		/* Only CPUs with RUNNABLE tasks of this group are affected */
+		if (bg->group[idx].tasks)
+			schedtune_cpu_update_clamps(bg);
+		raw_spin_unlock_irqrestore(&bg->lock, irq_flags);
+	}
+}
+
 #define ENQUEUE_TASK  1
 #define DEQUEUE_TASK -1
 
@@ -590,6 +659,40 @@ int schedtune_cpu_boost(int cpu)
 	return bg->boost_max;
 }
 
+unsigned long schedtune_cpu_clamp_util(int cpu, unsigned long util)
+{
+	struct boost_groups *bg;
+	int util_min, util_max;
+
+	bg = &per_cpu(cpu_boost_groups, cpu);
+	util_min = READ_ONCE(bg->util_min_max);
+	util_max = READ_ONCE(bg->util_max_max);
+
+	/* A floor requested by any group wins over a cap from another */
+	util = min_t(unsigned long, util, util_max);
+	return max_t(unsigned long, util, util_min);
+}
+
+unsigned long schedtune_task_clamp_util(struct task_struct *p,
+					unsigned long util)
+{
+	struct schedtune *st;
+	int util_min, util_max;
+
+	if (!unlikely(schedtune_initialized))
+		return util;
+
+	/* Get task utilization clamps */
+	rcu_read_lock();
+	st = task_schedtune(p);
+	util_min = st->util_min;
+	util_max = st->util_max;
+	rcu_read_unlock();
+
+	util = min_t(unsigned long, util, util_max);
+	return max_t(unsigned long, util, util_min);
+}
+
 int schedtune_task_boost(struct task_struct *p)
 {
 	struct schedtune *st;
@@ -642,6 +745,56 @@ prefer_idle_write(struct cgroup_subsys_state *css, struct cftype *cft,
 	return 0;
 }
 
+static u64
+util_min_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->util_min;
+}
+
+static int
+util_min_write(struct cgroup_subsys_state *css, struct cftype *cft,
+	       u64 util_min)
+{
+	struct schedtune *st = css_st(css);
+
+	if (util_min > st->util_max)
+		return -EINVAL;
+
+	st->util_min = util_min;
+
+	/* Update CPU clamps */
+	schedtune_clampgroup_update(st->idx, st->util_min, st->util_max);
+
+	return 0;
+}
+
+static u64
+util_max_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->util_max;
+}
+
+static int
+util_max_write(struct cgroup_subsys_state *css, struct cftype *cft,
+	       u64 util_max)
+{
+	struct schedtune *st = css_st(css);
+
+	if (util_max > SCHED_CAPACITY_SCALE || util_max < st->util_min)
+		return -EINVAL;
+
+	st->util_max = util_max;
+
+	/* Update CPU clamps */
+	schedtune_clampgroup_update(st->idx, st->util_min, st->util_max);
+
+	return 0;
+}
+
 static s64
 boost_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
@@ -698,6 +851,16 @@ static struct cftype files[] = {
 		.read_u64 = prefer_idle_read,
 		.write_u64 = prefer_idle_write,
 	},
+	{
+		.name = "util_min",
+		.read_u64 = util_min_read,
+		.write_u64 = util_min_write,
+	},
+	{
+		.name = "util_max",
+		.read_u64 = util_max_read,
+		.write_u64 = util_max_write,
+	},
 	{ }	/* terminate */
 };
 
@@ -711,12 +874,16 @@ schedtune_boostgroup_init(struct schedtune *st, int idx)
 	for_each_possible_cpu(cpu) {
 		bg = &per_cpu(cpu_boost_groups, cpu);
 		bg->group[idx].boost = 0;
+		bg->group[idx].util_min = 0;
+		bg->group[idx].util_max = SCHED_CAPACITY_SCALE;
 		bg->group[idx].valid = true;
 	}
 
 	/* Keep track of allocated boost groups */
 	allocated_group[idx] = st;
 	st->idx = idx;
+	st->util_min = 0;
+	st->util_max = SCHED_CAPACITY_SCALE;
 }
 
 static struct cgroup_subsys_state *
@@ -768,6 +935,8 @@ schedtune_boostgroup_release(struct schedtune *st)
 		bg = &per_cpu(cpu_boost_groups, cpu);
 		bg->group[st->idx].valid = false;
 		bg->group[st->idx].boost = 0;
+		bg->group[st->idx].util_min = 0;
+		bg->group[st->idx].util_max = SCHED_CAPACITY_SCALE;
 	}
 
 	/* Keep track of allocated boost groups */
@@ -803,6 +972,8 @@ schedtune_init_cgroups(void)
 	for_each_possible_cpu(cpu) {
 		bg = &per_cpu(cpu_boost_groups, cpu);
 		memset(bg, 0, sizeof(struct boost_groups));
+		bg->util_max_max = SCHED_CAPACITY_SCALE;
+		bg->group[0].util_max = SCHED_CAPACITY_SCALE;
 		bg->group[0].valid = true;
 		raw_spin_lock_init(&bg->lock);
 	}
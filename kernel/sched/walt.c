@@ -42,6 +42,9 @@ static __read_mostly unsigned int walt_io_is_busy = 0;
 
 unsigned int sysctl_sched_walt_init_task_load_pct = 15;
 
+/* Use predicted task demand for frequency selection and task placement */
+unsigned int sysctl_sched_walt_pred_demand = 1;
+
 /* true -> use PELT based load stats, false -> use window-based load stats */
 bool __read_mostly walt_disabled = false;
 
@@ -75,6 +78,7 @@ walt_inc_cumulative_runnable_avg(struct rq *rq,
 				 struct task_struct *p)
 {
 	rq->cumulative_runnable_avg += p->ravg.demand;
+	rq->cumulative_pred_demand += p->ravg.pred_demand;
 
 	/*
 	 * Add a task's contribution to the cumulative window demand when
@@ -93,6 +97,8 @@ walt_dec_cumulative_runnable_avg(struct rq *rq,
 {
 	rq->cumulative_runnable_avg -= p->ravg.demand;
 	BUG_ON((s64)rq->cumulative_runnable_avg < 0);
+	rq->cumulative_pred_demand -= p->ravg.pred_demand;
+	BUG_ON((s64)rq->cumulative_pred_demand < 0);
 
 	/*
 	 * on_rq will be 1 for sleeping tasks. So check if the task
@@ -105,15 +111,22 @@ walt_dec_cumulative_runnable_avg(struct rq *rq,
 
 static void
 fixup_cumulative_runnable_avg(struct rq *rq,
-			      struct task_struct *p, u64 new_task_load)
+			      struct task_struct *p, u64 new_task_load,
+			      u64 new_pred_demand)
 {
 	s64 task_load_delta = (s64)new_task_load - task_load(p);
+	s64 pred_demand_delta = (s64)new_pred_demand - p->ravg.pred_demand;
 
 	rq->cumulative_runnable_avg += task_load_delta;
 	if ((s64)rq->cumulative_runnable_avg < 0)
 		panic("cra less than zero: tld: %lld, task_load(p) = %u\n",
 			task_load_delta, task_load(p));
 
+	rq->cumulative_pred_demand += pred_demand_delta;
+	if ((s64)rq->cumulative_pred_demand < 0)
+		panic("cpd less than zero: pdd: %lld, pred_demand(p) = %u\n",
+			pred_demand_delta, p->ravg.pred_demand);
+
 	fixup_cum_window_demand(rq, task_load_delta);
 }
 
@@ -557,6 +570,159 @@ static int account_busy_for_task_demand(struct task_struct *p, int event)
 	return 1;
 }
 
+/*
+ * Busy time prediction. Each task keeps NUM_BUSY_BUCKETS counters, one per
+ * equal slice of the window. At every window rollover the counter for the
+ * slice the window's busy time fell into is bumped and all others decay, so
+ * a task that repeatedly bursts to the same level (e.g. a render thread at
+ * 60Hz) keeps that bucket populated across its idle windows. The predicted
+ * demand is then the most recent historical busy time that falls into the
+ * lowest populated bucket at or above the current busy time.
+ */
+#define INC_STEP		8
+#define DEC_STEP		2
+#define CONSISTENT_THRES	16
+#define INC_STEP_BIG		16
+
+static inline int busy_to_bucket(u32 normalized_rt)
+{
+	int bidx;
+
+	bidx = mult_frac(normalized_rt, NUM_BUSY_BUCKETS, walt_ravg_window);
+	bidx = min(bidx, NUM_BUSY_BUCKETS - 1);
+
+	/*
+	 * Combine the lowest two buckets. The lowest frequency already
+	 * covers the second bucket, so predicting the first one is useless.
+	 */
+	if (!bidx)
+		bidx++;
+
+	return bidx;
+}
+
+static void bucket_increase(u8 *buckets, int idx)
+{
+	int i, step;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++) {
+		if (idx != i) {
+			if (buckets[i] > DEC_STEP)
+				buckets[i] -= DEC_STEP;
+			else
+				buckets[i] = 0;
+		} else {
+			step = buckets[i] >= CONSISTENT_THRES ?
+						INC_STEP_BIG : INC_STEP;
+			if (buckets[i] > U8_MAX - step)
+				buckets[i] = U8_MAX;
+			else
+				buckets[i] += step;
+		}
+	}
+}
+
+static u32 get_pred_busy(struct task_struct *p, int start, u32 runtime)
+{
+	u8 *buckets = p->ravg.busy_buckets;
+	u32 *hist = p->ravg.sum_history;
+	u32 dmin, dmax;
+	int first = NUM_BUSY_BUCKETS;
+	u32 ret = runtime;
+	int i;
+
+	/* Skip prediction for new tasks due to lack of history */
+	if (p->ravg.active_windows < walt_ravg_hist_size)
+		return runtime;
+
+	/* Find the lowest populated bucket at or above 'start' */
+	for (i = start; i < NUM_BUSY_BUCKETS; i++) {
+		if (buckets[i]) {
+			first = i;
+			break;
+		}
+	}
+
+	/* If no higher buckets are populated, predict runtime */
+	if (first >= NUM_BUSY_BUCKETS)
+		return runtime;
+
+	/* Determine the demand range of the predicted bucket */
+	if (first < 2) {
+		/* Lowest two buckets are combined */
+		dmin = 0;
+		first = 1;
+	} else {
+		dmin = mult_frac(first, walt_ravg_window, NUM_BUSY_BUCKETS);
+	}
+	dmax = mult_frac(first + 1, walt_ravg_window, NUM_BUSY_BUCKETS);
+
+	/*
+	 * Search the runtime history for the most recent sample within the
+	 * predicted bucket, falling back to the middle of the bucket.
+	 */
+	for (i = 0; i < walt_ravg_hist_size; i++) {
+		if (hist[i] >= dmin && hist[i] < dmax) {
+			ret = hist[i];
+			break;
+		}
+	}
+	if (ret < dmin)
+		ret = (dmin + dmax) / 2;
+
+	/*
+	 * When updating in the middle of a window, runtime could be higher
+	 * than anything recorded. Always predict at least runtime.
+	 */
+	return max(runtime, ret);
+}
+
+static inline u32 predict_and_update_buckets(struct task_struct *p,
+					     u32 runtime)
+{
+	int bidx = busy_to_bucket(runtime);
+	u32 pred_demand = get_pred_busy(p, bidx, runtime);
+
+	bucket_increase(p->ravg.busy_buckets, bidx);
+
+	return pred_demand;
+}
+
+/*
+ * The predicted demand is computed at window rollover. If the task's busy
+ * time in the current window has already exceeded it, raise it here so the
+ * prediction keeps up with a burst that is bigger than anything seen.
+ */
+static void update_task_pred_demand(struct rq *rq, struct task_struct *p,
+				    int event)
+{
+	u32 new;
+
+	if (is_idle_task(p) || exiting_task(p))
+		return;
+
+	if (event != PUT_PREV_TASK && event != TASK_UPDATE &&
+	    (!walt_freq_account_wait_time ||
+	     (event != TASK_MIGRATE && event != PICK_NEXT_TASK)))
+		return;
+
+	/* TASK_UPDATE can be called on a sleeping task */
+	if (event == TASK_UPDATE && !p->on_rq && !walt_freq_account_wait_time)
+		return;
+
+	if (p->ravg.pred_demand >= p->ravg.curr_window)
+		return;
+
+	new = get_pred_busy(p, busy_to_bucket(p->ravg.curr_window),
+			    p->ravg.curr_window);
+
+	if (task_on_rq_queued(p) && (!task_has_dl_policy(p) ||
+				     !p->dl.dl_throttled))
+		fixup_cumulative_runnable_avg(rq, p, p->ravg.demand, new);
+
+	p->ravg.pred_demand = new;
+}
+
 /*
  * Called when new window is starting for a task, to record cpu usage over
  * recently concluded window(s). Normally 'samples' should be 1. It can be > 1
@@ -568,13 +734,15 @@ static void update_history(struct rq *rq, struct task_struct *p,
 {
 	u32 *hist = &p->ravg.sum_history[0];
 	int ridx, widx;
-	u32 max = 0, avg, demand;
+	u32 max = 0, avg, demand, pred_demand;
 	u64 sum = 0;
 
 	/* Ignore windows where task had no activity */
 	if (!runtime || is_idle_task(p) || exiting_task(p) || !samples)
 			goto done;
 
+	pred_demand = predict_and_update_buckets(p, runtime);
+
 	/* Push new 'runtime' value onto stack */
 	widx = walt_ravg_hist_size - 1;
 	ridx = widx - samples;
@@ -620,12 +788,14 @@ static void update_history(struct rq *rq, struct task_struct *p,
 	 */
 	if (!task_has_dl_policy(p) || !p->dl.dl_throttled) {
 		if (task_on_rq_queued(p))
-			fixup_cumulative_runnable_avg(rq, p, demand);
+			fixup_cumulative_runnable_avg(rq, p, demand,
+						      pred_demand);
 		else if (rq->curr == p)
 			fixup_cum_window_demand(rq, demand);
 	}
 
 	p->ravg.demand = demand;
+	p->ravg.pred_demand = pred_demand;
 
 done:
 	trace_walt_update_history(rq, p, runtime, samples, event);
@@ -759,6 +929,7 @@ void walt_update_task_ravg(struct task_struct *p, struct rq *rq,
 
 	update_task_demand(p, rq, event, wallclock);
 	update_cpu_busy_time(p, rq, event, wallclock, irqtime);
+	update_task_pred_demand(rq, p, event);
 
 done:
 	trace_walt_update_task_ravg(p, rq, event, wallclock, irqtime);
@@ -898,6 +1069,7 @@ void walt_init_new_task_load(struct task_struct *p)
 	}
 
 	p->ravg.demand = init_load_windows;
+	p->ravg.pred_demand = init_load_windows;
 	for (i = 0; i < RAVG_HIST_SIZE_MAX; ++i)
 		p->ravg.sum_history[i] = init_load_windows;
 }
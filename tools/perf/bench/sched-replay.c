@@ -0,0 +1,410 @@
+/*
+ *
+ * sched-replay.c
+ *
+ * replay: Replay a periodic workload and report how well it was served
+ *
+ * Each line of the workload description describes one periodic thread,
+ * similar to an rt-app task:
+ *
+ *   <name> <period_us> <runtime_us> [<burst_every> <burst_runtime_us>]
+ *
+ * Every activation the thread consumes <runtime_us> of CPU time, except
+ * every <burst_every>th one which consumes <burst_runtime_us> (e.g. a render
+ * thread producing a heavier frame). Lines starting with '#' are ignored.
+ * Without a workload file, a small 60Hz UI-style workload is replayed.
+ *
+ * Reported per thread are deadline misses (activation not completed by the
+ * start of the next period) and wakeup latency (timer expiry to the thread
+ * running). Reported per run is where the replay threads ran, per cluster,
+ * and the system-wide cpufreq time_in_state residency over the replay, which
+ * includes time spent running anything else.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/time64.h>
+
+#define REPLAY_MAX_THREADS	64
+#define REPLAY_MAX_FREQS	64
+#define REPLAY_MAX_POLICIES	16
+#define REPLAY_MAX_CLUSTERS	16
+
+struct replay_thread {
+	char			name[32];
+	u64			period_ns;
+	u64			runtime_ns;
+	unsigned int		burst_every;
+	u64			burst_runtime_ns;
+	pthread_t		pthread;
+
+	/* results */
+	u64			activations;
+	u64			misses;
+	u64			lat_sum_ns;
+	u64			lat_max_ns;
+	u64			*cpu_time_ns;
+};
+
+struct freq_residency {
+	unsigned int		policy;
+	int			nr_freqs;
+	unsigned long		freq[REPLAY_MAX_FREQS];
+	unsigned long long	time[REPLAY_MAX_FREQS];
+};
+
+/* UI and render threads at 60Hz with a heavy frame every 8th, plus a logger */
+static const char * const default_workload[] = {
+	"ui 16667 2000 8 6000",
+	"render 16667 4000 8 10000",
+	"logger 100000 1000",
+	NULL
+};
+
+static const char		*workload;
+static unsigned int		duration = 10;
+
+static struct replay_thread	threads[REPLAY_MAX_THREADS];
+static int			nr_threads;
+static int			nr_cpus;
+static struct timespec		start_ts;
+static u64			end_ns;
+
+static const struct option options[] = {
+	OPT_STRING('w', "workload",	&workload,	"file",	"Workload description to replay"),
+	OPT_UINTEGER('d', "duration",	&duration,	"Replay duration in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_sched_replay_usage[] = {
+	"perf bench sched replay <options>",
+	NULL
+};
+
+static u64 ts_to_ns(const struct timespec *ts)
+{
+	return (u64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_ts(u64 ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static u64 clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts_to_ns(&ts);
+}
+
+static int parse_thread(const char *line)
+{
+	unsigned long long period_us, runtime_us, burst_runtime_us = 0;
+	struct replay_thread *t;
+	int n;
+
+	if (nr_threads == REPLAY_MAX_THREADS) {
+		fprintf(stderr, "Too many threads, max %d\n", REPLAY_MAX_THREADS);
+		return -1;
+	}
+
+	t = &threads[nr_threads];
+	t->burst_every = 0;
+
+	n = sscanf(line, "%31s %llu %llu %u %llu", t->name, &period_us,
+		   &runtime_us, &t->burst_every, &burst_runtime_us);
+	if ((n != 3 && n != 5) || !period_us || runtime_us > period_us)
+		return -1;
+
+	t->period_ns = period_us * NSEC_PER_USEC;
+	t->runtime_ns = runtime_us * NSEC_PER_USEC;
+	t->burst_runtime_ns = burst_runtime_us * NSEC_PER_USEC;
+	t->cpu_time_ns = zalloc(nr_cpus * sizeof(u64));
+	BUG_ON(!t->cpu_time_ns);
+	nr_threads++;
+
+	return 0;
+}
+
+static int parse_workload(const char *path)
+{
+	char line[256];
+	int lineno = 0;
+	FILE *f;
+
+	if (!path) {
+		for (lineno = 0; default_workload[lineno]; lineno++)
+			BUG_ON(parse_thread(default_workload[lineno]));
+		return 0;
+	}
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Cannot open workload %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (parse_thread(line)) {
+			fprintf(stderr, "%s:%d: invalid thread description\n", path, lineno);
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+
+	if (!nr_threads) {
+		fprintf(stderr, "%s: no threads described\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Consume @runtime_ns of CPU time, attributing it to the CPUs it ran on.
+ */
+static void burn(struct replay_thread *t, u64 runtime_ns)
+{
+	u64 start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	u64 last = start, now;
+	int cpu;
+
+	do {
+		now = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+		cpu = sched_getcpu();
+		if (cpu >= 0 && cpu < nr_cpus)
+			t->cpu_time_ns[cpu] += now - last;
+		last = now;
+	} while (now - start < runtime_ns);
+}
+
+static void *replay_thread(void *arg)
+{
+	struct replay_thread *t = arg;
+	u64 activation = ts_to_ns(&start_ts);
+	struct timespec ts;
+	u64 now, lat;
+
+	while (activation < end_ns) {
+		ns_to_ts(activation, &ts);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+
+		now = clock_ns(CLOCK_MONOTONIC);
+		lat = now - activation;
+		t->lat_sum_ns += lat;
+		if (lat > t->lat_max_ns)
+			t->lat_max_ns = lat;
+
+		t->activations++;
+		if (t->burst_every && !(t->activations % t->burst_every))
+			burn(t, t->burst_runtime_ns);
+		else
+			burn(t, t->runtime_ns);
+
+		activation += t->period_ns;
+
+		/* Missed the deadline; skip the activations we overran */
+		now = clock_ns(CLOCK_MONOTONIC);
+		if (now > activation) {
+			t->misses++;
+			while (activation < now)
+				activation += t->period_ns;
+		}
+	}
+
+	return NULL;
+}
+
+static int cpu_cluster(int cpu)
+{
+	char path[PATH_MAX];
+	int id = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &id) != 1)
+		id = -1;
+	fclose(f);
+
+	return id;
+}
+
+static int read_freq_residency(struct freq_residency *res)
+{
+	const char *dir = "/sys/devices/system/cpu/cpufreq";
+	char path[PATH_MAX];
+	struct dirent *d;
+	int nr = 0;
+	DIR *cpufreq;
+	FILE *f;
+
+	cpufreq = opendir(dir);
+	if (!cpufreq)
+		return 0;
+
+	while ((d = readdir(cpufreq)) && nr < REPLAY_MAX_POLICIES) {
+		struct freq_residency *r = &res[nr];
+
+		if (sscanf(d->d_name, "policy%u", &r->policy) != 1)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s/stats/time_in_state",
+			 dir, d->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+
+		r->nr_freqs = 0;
+		while (r->nr_freqs < REPLAY_MAX_FREQS &&
+		       fscanf(f, "%lu %llu", &r->freq[r->nr_freqs],
+			      &r->time[r->nr_freqs]) == 2)
+			r->nr_freqs++;
+		fclose(f);
+		nr++;
+	}
+
+	closedir(cpufreq);
+	return nr;
+}
+
+static void print_results(struct freq_residency *before,
+			  struct freq_residency *after, int nr_policies)
+{
+	struct replay_thread *t;
+	u64 cluster_ns[REPLAY_MAX_CLUSTERS] = { 0 };
+	int max_cluster = -1;
+	int i, cpu, cl;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		for (i = 0; i < nr_threads; i++) {
+			t = &threads[i];
+			printf("%s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+			       t->name, t->activations, t->misses,
+			       t->activations ? t->lat_sum_ns / t->activations / NSEC_PER_USEC : 0,
+			       t->lat_max_ns / NSEC_PER_USEC);
+		}
+		return;
+	}
+
+	printf("# Replayed %d threads from %s for %u sec\n\n", nr_threads,
+	       workload ?: "the default workload", duration);
+	printf(" %-16s %10s %10s %11s %7s %12s %12s\n", "thread", "period(us)",
+	       "run(us)", "activations", "misses", "lat avg(us)", "lat max(us)");
+
+	for (i = 0; i < nr_threads; i++) {
+		t = &threads[i];
+		printf(" %-16s %10" PRIu64 " %10" PRIu64 " %11" PRIu64 " %7" PRIu64
+		       " %12" PRIu64 " %12" PRIu64 "\n",
+		       t->name, t->period_ns / NSEC_PER_USEC,
+		       t->runtime_ns / NSEC_PER_USEC, t->activations, t->misses,
+		       t->activations ? t->lat_sum_ns / t->activations / NSEC_PER_USEC : 0,
+		       t->lat_max_ns / NSEC_PER_USEC);
+
+		for (cpu = 0; cpu < nr_cpus; cpu++) {
+			cl = cpu_cluster(cpu);
+			if (cl < 0 || cl >= REPLAY_MAX_CLUSTERS)
+				continue;
+			cluster_ns[cl] += t->cpu_time_ns[cpu];
+			if (cl > max_cluster)
+				max_cluster = cl;
+		}
+	}
+
+	printf("\n# Replay CPU time per cluster\n\n");
+	for (cl = 0; cl <= max_cluster; cl++)
+		printf(" cluster%-3d %12" PRIu64 " ms\n", cl, cluster_ns[cl] / NSEC_PER_MSEC);
+
+	if (!nr_policies)
+		return;
+
+	printf("\n# Frequency residency during the replay (ms)\n\n");
+	for (i = 0; i < nr_policies; i++) {
+		struct freq_residency *b = &before[i], *a = NULL;
+		int j, f;
+
+		for (j = 0; j < nr_policies; j++) {
+			if (after[j].policy == b->policy) {
+				a = &after[j];
+				break;
+			}
+		}
+		if (!a || a->nr_freqs != b->nr_freqs)
+			continue;
+
+		printf(" policy%u\n", b->policy);
+		for (f = 0; f < b->nr_freqs; f++) {
+			/* time_in_state is in units of 10ms */
+			printf("   %10lu kHz %12llu\n", b->freq[f],
+			       (a->time[f] - b->time[f]) * 10);
+		}
+	}
+}
+
+int bench_sched_replay(int argc, const char **argv, const char *prefix __maybe_unused)
+{
+	static struct freq_residency before[REPLAY_MAX_POLICIES];
+	static struct freq_residency after[REPLAY_MAX_POLICIES];
+	int nr_policies;
+	int i, ret;
+
+	argc = parse_options(argc, argv, options, bench_sched_replay_usage, 0);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	BUG_ON(nr_cpus <= 0);
+
+	if (parse_workload(workload))
+		return 1;
+
+	nr_policies = read_freq_residency(before);
+
+	/* Give all threads time to be created before the first activation */
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+	ns_to_ts(ts_to_ns(&start_ts) + 100 * NSEC_PER_MSEC, &start_ts);
+	end_ns = ts_to_ns(&start_ts) + (u64)duration * NSEC_PER_SEC;
+
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&threads[i].pthread, NULL, replay_thread, &threads[i]);
+		BUG_ON(ret);
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_join(threads[i].pthread, NULL);
+		BUG_ON(ret);
+	}
+
+	if (nr_policies && read_freq_residency(after) != nr_policies)
+		nr_policies = 0;
+
+	print_results(before, after, nr_policies);
+
+	for (i = 0; i < nr_threads; i++)
+		zfree(&threads[i].cpu_time_ns);
+
+	return 0;
+}